@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai.h"
+#include "eval.h"
+
+#define DEAD -1e30f // Value of a board that ended the game
+
+const AiWeights AI_DEFAULT_WEIGHTS = {
+    .height = -0.51f,
+    .holes = -0.36f,
+    .transitions = -0.05f,
+    .bumpiness = -0.18f,
+    .wells = -0.10f,
+    .lines = 0.76f,
+};
+
+// A board kept in the beam and the root placement it came from.
+typedef struct {
+    GameState g;
+    float lines; // Line reward so far
+    Placement first;
+} Node;
+
+typedef struct {
+    float value;
+    uint32_t hash; // Low half of game_hash() after the placement
+    int parent;
+    Placement p;
+} Child;
+
+struct Ai {
+    AiConfig c;
+    Node *nodes, *next;
+    Child *children; // MOVEGEN_MAX slots per node
+    int *counts;     // Children per node
+    Child **top;     // Best children, best first
+};
+
+void ai_config_init(AiConfig *c) {
+    c->weights = AI_DEFAULT_WEIGHTS;
+    c->depth = AI_DEFAULT_DEPTH;
+    c->beam = AI_DEFAULT_BEAM;
+    c->pool = NULL;
+    c->tt = NULL;
+}
+
+Ai *ai_create(const AiConfig *c) {
+    Ai *ai = calloc(1, sizeof(*ai));
+    if (!ai) return NULL;
+    ai->c = *c;
+    if (ai->c.depth < 1) ai->c.depth = 1;
+    if (ai->c.depth > NEXT_COUNT) ai->c.depth = NEXT_COUNT;
+    if (ai->c.beam < 1) ai->c.beam = 1;
+
+    int beam = ai->c.beam;
+    ai->nodes = malloc(beam * sizeof(Node));
+    ai->next = malloc(beam * sizeof(Node));
+    ai->children = malloc((size_t)beam * MOVEGEN_MAX * sizeof(Child));
+    ai->counts = malloc(beam * sizeof(int));
+    ai->top = malloc(beam * sizeof(Child *));
+    if (!ai->nodes || !ai->next || !ai->children || !ai->counts || !ai->top) {
+        ai_destroy(ai);
+        return NULL;
+    }
+    return ai;
+}
+
+void ai_destroy(Ai *ai) {
+    if (!ai) return;
+    free(ai->nodes);
+    free(ai->next);
+    free(ai->children);
+    free(ai->counts);
+    free(ai->top);
+    free(ai);
+}
+
+static float score(const AiWeights *w, int height, int holes, int transitions, int bumpiness, int wells) {
+    return w->height * height + w->holes * holes + w->transitions * transitions +
+           w->bumpiness * bumpiness + w->wells * wells;
+}
+
+float ai_evaluate(const GameState *g, const AiWeights *w) {
+    BoardFeatures f;
+    board_features(g->rows, g->width, g->height, &f);
+    return score(w, f.height, f.holes, f.transitions, f.bumpiness, f.wells);
+}
+
+// --- Search ---
+// What a placement is worth from its parent: value of the lines it clears
+// plus the score of the board it leaves. That plus the child's hash is
+// what the transposition table keeps, keyed by parent state and placement.
+static uint64_t child_key(uint64_t parent, const Placement *p) {
+    uint64_t code = p->piece.type | p->piece.rot << 3 | (uint8_t)p->x << 5 | (uint8_t)p->y << 13 | p->hold << 21;
+    return rng_mix(parent ^ code);
+}
+
+static uint64_t pack(float gain, uint32_t hash) {
+    uint32_t bits;
+    memcpy(&bits, &gain, sizeof(bits));
+    return (uint64_t)hash << 32 | bits;
+}
+
+static float unpack_gain(uint64_t data) {
+    uint32_t bits = (uint32_t)data;
+    float gain;
+    memcpy(&gain, &bits, sizeof(gain));
+    return gain;
+}
+
+// Scores every placement of each node in [begin, end). Placements the
+// table knows are done; the others are played out and their boards rated
+// a block at a time. Nodes write only their own child slots, so any
+// worker can take any node.
+static void expand(void *ctx, long begin, long end, int worker) {
+    (void)worker;
+    Ai *ai = ctx;
+    const AiWeights *w = &ai->c.weights;
+    TTable *tt = ai->c.tt;
+    Placement pl[MOVEGEN_MAX];
+    uint64_t keys[MOVEGEN_MAX];
+    float lines[MOVEGEN_MAX];
+    uint8_t todo[MOVEGEN_MAX]; // Children needing a board score
+    BoardBlock boards[MOVEGEN_MAX / EVAL_LANES];
+    FeatureBlock features[MOVEGEN_MAX / EVAL_LANES];
+    for (long i = begin; i < end; i++) {
+        const Node *n = &ai->nodes[i];
+        Child *out = ai->children + i * MOVEGEN_MAX;
+        uint64_t parent = tt ? game_hash(&n->g) : 0;
+        int count = gen_placements(&n->g, pl, NULL, MOVEGEN_MAX), queued = 0;
+        for (int k = 0; tt && k < count; k++) {
+            keys[k] = child_key(parent, &pl[k]);
+            tt_prefetch(tt, keys[k]);
+        }
+        for (int k = 0; k < count; k++) {
+            out[k].parent = (int)i;
+            out[k].p = pl[k];
+            uint64_t data;
+            if (tt && tt_probe(tt, keys[k], &data)) {
+                float gain = unpack_gain(data);
+                out[k].value = gain == DEAD ? DEAD : n->lines + gain;
+                out[k].hash = (uint32_t)(data >> 32);
+                continue;
+            }
+
+            GameState c;
+            game_copy(&c, &n->g);
+            game_place(&c, &pl[k]);
+            out[k].hash = (uint32_t)game_hash(&c);
+            if (c.state == GAME_OVER) {
+                out[k].value = DEAD;
+                if (tt) tt_store(tt, keys[k], pack(DEAD, out[k].hash), 0);
+                continue;
+            }
+            lines[k] = w->lines * (c.lines_cleared_total - n->g.lines_cleared_total);
+            BoardBlock *b = &boards[queued / EVAL_LANES];
+            for (int y = 0; y < c.height; y++) b->rows[y][queued % EVAL_LANES] = c.rows[y];
+            todo[queued++] = (uint8_t)k;
+        }
+
+        eval_blocks(boards, features, (queued + EVAL_LANES - 1) / EVAL_LANES, n->g.width, n->g.height);
+        for (int q = 0; q < queued; q++) {
+            const FeatureBlock *f = &features[q / EVAL_LANES];
+            int lane = q % EVAL_LANES, k = todo[q];
+            float gain = lines[k] + score(w, f->height[lane], f->holes[lane], f->transitions[lane],
+                                          f->bumpiness[lane], f->wells[lane]);
+            out[k].value = n->lines + gain;
+            if (tt) tt_store(tt, keys[k], pack(gain, out[k].hash), 0);
+        }
+        ai->counts[i] = count;
+    }
+}
+
+// Keeps the best `beam` children in ai->top, each state once: the same
+// board and queue reached through other placements is a transposition.
+// Ties go to the earlier child, so the result does not depend on which
+// worker expanded what.
+static int select_top(Ai *ai, int nodes) {
+    int kept = 0, beam = ai->c.beam;
+    for (int i = 0; i < nodes; i++) {
+        Child *kids = ai->children + (size_t)i * MOVEGEN_MAX;
+        for (int k = 0; k < ai->counts[i]; k++) {
+            Child *c = &kids[k];
+            if (kept == beam && c->value <= ai->top[kept - 1]->value) continue;
+            int seen = 0;
+            for (int j = 0; j < kept && !seen; j++) seen = ai->top[j]->hash == c->hash;
+            if (seen) continue;
+            int j = kept < beam ? kept++ : kept - 1;
+            for (; j > 0 && ai->top[j - 1]->value < c->value; j--) ai->top[j] = ai->top[j - 1];
+            ai->top[j] = c;
+        }
+    }
+    return kept;
+}
+
+int ai_choose(Ai *ai, const GameState *g, Placement *best) {
+    int nodes = 1, found = 0;
+    game_copy(&ai->nodes[0].g, g);
+    ai->nodes[0].lines = 0;
+
+    for (int level = 0; level < ai->c.depth; level++) {
+        if (ai->c.pool) pool_parallel_for(ai->c.pool, nodes, 1, expand, ai);
+        else expand(ai, 0, nodes, 0);
+
+        int kept = select_top(ai, nodes);
+        if (kept == 0) break;
+        *best = level == 0 ? ai->top[0]->p : ai->nodes[ai->top[0]->parent].first;
+        found = 1;
+        if (level + 1 == ai->c.depth) break;
+
+        for (int t = 0; t < kept; t++) {
+            const Child *c = ai->top[t];
+            const Node *parent = &ai->nodes[c->parent];
+            Node *n = &ai->next[t];
+            game_copy(&n->g, &parent->g);
+            game_place(&n->g, &c->p);
+            n->lines = parent->lines + ai->c.weights.lines * (n->g.lines_cleared_total - parent->g.lines_cleared_total);
+            n->first = level == 0 ? c->p : parent->first;
+        }
+        Node *swap = ai->nodes;
+        ai->nodes = ai->next;
+        ai->next = swap;
+        nodes = kept;
+    }
+    return found;
+}
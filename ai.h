@@ -0,0 +1,51 @@
+#ifndef TETRIS_AI_H
+#define TETRIS_AI_H
+
+#include "engine.h"
+#include "movegen.h"
+#include "pool.h"
+#include "tt.h"
+
+// Autoplayer. A beam search places the current piece and the visible queue
+// (hold included) and keeps the best `beam` boards of every level, scored
+// by a weighted sum of board features plus the lines cleared on the way.
+// It never looks past the preview, so it plays fair.
+
+typedef struct {
+    float height;      // Sum of column heights
+    float holes;       // Empty cells with a filled cell above
+    float transitions; // Filled/empty changes along rows, walls filled
+    float bumpiness;   // Height steps between neighbouring columns
+    float wells;       // Depth of columns lower than both neighbours
+    float lines;       // Per line cleared
+} AiWeights;
+
+extern const AiWeights AI_DEFAULT_WEIGHTS;
+
+typedef struct {
+    AiWeights weights;
+    int depth;  // Pieces placed per search, at most NEXT_COUNT
+    int beam;   // Boards kept per level
+    Pool *pool; // Expands each level's boards in parallel; NULL runs inline
+    TTable *tt; // Remembers scored placements across searches and threads
+} AiConfig;
+
+#define AI_DEFAULT_DEPTH NEXT_COUNT
+#define AI_DEFAULT_BEAM 8
+
+typedef struct Ai Ai;
+
+// Default weights, depth and beam, no pool or table.
+void ai_config_init(AiConfig *c);
+// Holds the search buffers, so one Ai serves one caller at a time.
+Ai *ai_create(const AiConfig *c);
+void ai_destroy(Ai *ai);
+
+// Higher is better. The search rates boards in batches with eval.h; this
+// is the same score for one board.
+float ai_evaluate(const GameState *g, const AiWeights *w);
+// Picks where the current piece goes. Equal inputs give equal choices,
+// whatever the pool size. Returns 0 when the piece has nowhere to go.
+int ai_choose(Ai *ai, const GameState *g, Placement *best);
+
+#endif
@@ -0,0 +1,451 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "movegen.h"
+#include "render.h"
+
+// Benchmark suite: engine primitives, the renderer and whole headless
+// games, each timed on fixed deterministic inputs. A case first doubles
+// its iteration count until one batch takes --min-ms, then runs BATCHES
+// batches and reports the fastest, which filters out scheduler noise.
+// Cycles, instructions and cache misses come from perf_event_open() over
+// that fastest batch when the kernel allows it. Render output goes to the
+// Screen's buffer, never to a tty.
+
+#define BATCHES 5
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// --- Counters ---
+// One group read at once, so the three counts cover the same instructions.
+enum { CNT_CYCLES, CNT_INSTRUCTIONS, CNT_CACHE_MISSES, COUNTERS };
+
+static int counter_fd[COUNTERS] = { -1, -1, -1 };
+
+static int perf_open(uint64_t config, int group) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config;
+    a.disabled = group == -1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, group, 0);
+}
+
+// Returns 0 when the counters are not available here: no PMU, a VM
+// without one, or perf_event_paranoid too strict.
+static int counters_open() {
+    static const uint64_t configs[COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+    };
+    for (int i = 0; i < COUNTERS; i++) {
+        counter_fd[i] = perf_open(configs[i], i == 0 ? -1 : counter_fd[0]);
+        if (counter_fd[i] == -1) {
+            for (int k = 0; k < i; k++) close(counter_fd[k]);
+            counter_fd[0] = -1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void counters_start() {
+    if (counter_fd[0] == -1) return;
+    ioctl(counter_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counter_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Counts since counters_start(), scaled up if the PMU was shared.
+static int counters_stop(double out[COUNTERS]) {
+    if (counter_fd[0] == -1) return 0;
+    ioctl(counter_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t buf[3 + COUNTERS]; // nr, time enabled, time running, values
+    if (read(counter_fd[0], buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[2] == 0) return 0;
+    double scale = (double)buf[1] / buf[2];
+    for (int i = 0; i < COUNTERS; i++) out[i] = buf[3 + i] * scale;
+    return 1;
+}
+
+// --- Runner ---
+// Runs `iters` operations; *bytes may collect output sizes.
+typedef void (*BenchFn)(void *ctx, long iters, size_t *bytes);
+
+typedef struct {
+    const char *name;
+    double ns;               // Per operation
+    double counts[COUNTERS]; // Per operation, when have_counts
+    int have_counts;
+    double bytes;            // Per operation, when the case writes output
+    long iters;
+} Result;
+
+typedef struct {
+    int json;
+    double min_ns; // Shortest batch
+    const char *filter;
+    Result *prev; // --compare baseline
+    int n_prev;
+    int first;    // No JSON record printed yet
+} Options;
+
+static const Result *find_prev(const Options *o, const char *name) {
+    for (int i = 0; i < o->n_prev; i++) {
+        if (!strcmp(o->prev[i].name, name)) return &o->prev[i];
+    }
+    return NULL;
+}
+
+static void report(Options *o, const Result *r) {
+    if (o->json) {
+        printf("%s\n  {\"name\": \"%s\", \"iters\": %ld, \"ns_per_op\": %.3f", o->first ? "" : ",", r->name, r->iters,
+               r->ns);
+        static const char *keys[COUNTERS] = { "cycles", "instructions", "cache_misses" };
+        for (int i = 0; i < COUNTERS; i++) {
+            if (r->have_counts) printf(", \"%s\": %.3f", keys[i], r->counts[i]);
+            else printf(", \"%s\": null", keys[i]);
+        }
+        printf(", \"bytes_per_op\": %.1f}", r->bytes);
+        o->first = 0;
+        return;
+    }
+    printf("%-24s %12.1f ns/op", r->name, r->ns);
+    if (r->have_counts) {
+        printf(" %10.0f cyc %10.0f ins %6.2f IPC %8.2f miss", r->counts[CNT_CYCLES], r->counts[CNT_INSTRUCTIONS],
+               r->counts[CNT_INSTRUCTIONS] / (r->counts[CNT_CYCLES] > 0 ? r->counts[CNT_CYCLES] : 1),
+               r->counts[CNT_CACHE_MISSES]);
+    }
+    if (r->bytes > 0) printf(" %10.0f B/op", r->bytes);
+    const Result *p = find_prev(o, r->name);
+    if (p && p->ns > 0) printf("  %+6.1f%%", (r->ns / p->ns - 1) * 100);
+    putchar('\n');
+}
+
+static void run(Options *o, const char *name, BenchFn fn, void *ctx) {
+    if (o->filter && !strstr(name, o->filter)) return;
+    size_t bytes = 0;
+    long iters = 1;
+    for (;;) {
+        double t0 = now_ns();
+        fn(ctx, iters, &bytes);
+        if (now_ns() - t0 >= o->min_ns || iters >= 1L << 40) break;
+        iters *= 2;
+    }
+
+    Result r = { name, 0, { 0 }, 0, 0, iters };
+    for (int b = 0; b < BATCHES; b++) {
+        double counts[COUNTERS];
+        bytes = 0;
+        counters_start();
+        double t0 = now_ns();
+        fn(ctx, iters, &bytes);
+        double elapsed = now_ns() - t0;
+        int have = counters_stop(counts);
+        if (b > 0 && elapsed >= r.ns) continue;
+        r.ns = elapsed;
+        r.bytes = (double)bytes / iters;
+        r.have_counts = have;
+        for (int i = 0; i < COUNTERS; i++) r.counts[i] = have ? counts[i] / iters : 0;
+    }
+    r.ns /= iters;
+    report(o, &r);
+}
+
+// Reads the records of an earlier --json run, one per line.
+static int load_prev(Options *o, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[512];
+    int cap = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        double ns;
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"iters\": %*d, \"ns_per_op\": %lf", name, &ns) != 2) continue;
+        if (o->n_prev == cap) {
+            cap = cap ? cap * 2 : 32;
+            Result *grown = realloc(o->prev, cap * sizeof(Result));
+            if (!grown) break;
+            o->prev = grown;
+        }
+        Result *r = &o->prev[o->n_prev++];
+        memset(r, 0, sizeof(*r));
+        r->name = strdup(name);
+        r->ns = ns;
+    }
+    fclose(f);
+    return 0;
+}
+
+// --- Positions ---
+// A deterministic mid-game position: eight ragged rows of garbage, a
+// held piece and a non-zero score.
+static void setup_position(GameState *g) {
+    game_init(g, 12345);
+    for (int y = BOARD_HEIGHT - 8; y < BOARD_HEIGHT; y++) {
+        int hole = (y * 3) % BOARD_WIDTH;
+        g->rows[y] = FULL_ROW(BOARD_WIDTH) & ~(1u << hole);
+        for (int x = 0; x < BOARD_WIDTH; x++) g->color[y][x] = x == hole ? 0 : 1 + (x + y) % 7;
+    }
+    game_update_heights(g);
+    game_rehash(g);
+    g->score = 123450;
+    g->lines_cleared_total = 42;
+    g->level = 5;
+    game_apply(g, ACT_HOLD);
+}
+
+// A vertical I over column 0 of a four-row well whose bottom `lines` rows
+// are full but for that column, so its hard drop clears exactly that many.
+static void setup_lock(GameState *g, int lines) {
+    setup_position(g);
+    game_reset(g);
+    for (int y = BOARD_HEIGHT - 4; y < BOARD_HEIGHT; y++) {
+        int full = y >= BOARD_HEIGHT - lines;
+        g->rows[y] = FULL_ROW(BOARD_WIDTH) & ~1u & ~(full ? 0u : 1u << 5);
+        for (int x = 0; x < BOARD_WIDTH; x++) g->color[y][x] = g->rows[y] >> x & 1 ? 1 + x % 7 : 0;
+    }
+    game_update_heights(g);
+    game_rehash(g);
+    g->current_piece.type = PIECE_I;
+    g->current_piece.rot = 1;
+    g->piece_x = -PIECES[PIECE_I][1].left;
+    g->piece_y = 0;
+}
+
+// --- Engine Cases ---
+#define PROBES 256
+
+typedef struct {
+    GameState g;
+    Tetromino piece[PROBES];
+    int x[PROBES], y[PROBES];
+} Probes;
+
+// Every piece and rotation over a spread of columns and rows, some clear,
+// some in the stack and some past the walls.
+static void setup_probes(Probes *p) {
+    setup_position(&p->g);
+    Rng rng;
+    rng_seed(&rng, 7);
+    for (int i = 0; i < PROBES; i++) {
+        p->piece[i].type = (uint8_t)rng_below(&rng, PIECE_TYPES);
+        p->piece[i].rot = (uint8_t)rng_below(&rng, 4);
+        p->x[i] = (int)rng_below(&rng, BOARD_WIDTH + 2) - 2;
+        p->y[i] = (int)rng_below(&rng, BOARD_HEIGHT);
+    }
+}
+
+static void bench_collision(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const Probes *p = ctx;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        int k = i & (PROBES - 1);
+        sink += check_collision(&p->g, &p->piece[k], p->x[k], p->y[k]);
+    }
+}
+
+static void bench_rotate(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const Probes *p = ctx;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        int k = i & (PROBES - 1);
+        Tetromino t = p->piece[k];
+        int x = p->x[k], y = p->y[k];
+        sink += piece_rotate(&p->g, &t, &x, &y);
+    }
+}
+
+// The current piece moved through the probes' columns at the top, so the
+// fast path from column heights and the probing one under the overhangs
+// both run.
+static void bench_ghost(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const Probes *p = ctx;
+    GameState g = p->g;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        int k = i & (PROBES - 1);
+        g.current_piece = p->piece[k];
+        const PieceShape *m = PIECE_SHAPE(&g.current_piece);
+        g.piece_x = -m->left + (k % (BOARD_WIDTH - m->width + 1));
+        g.piece_y = k & 4 ? 0 : 10;
+        sink += game_ghost_y(&g);
+    }
+}
+
+static void bench_copy(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const GameState *start = ctx;
+    GameState g;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        game_copy(&g, start);
+        sink += g.score;
+    }
+}
+
+// Copy, hard drop, lock; the copy is timed on its own as "game_copy".
+static void bench_lock(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const GameState *start = ctx;
+    GameState g;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        game_copy(&g, start);
+        game_apply(&g, ACT_HARD_DROP);
+        sink += g.lines_cleared_total;
+    }
+}
+
+static void bench_movegen(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    const GameState *g = ctx;
+    Placement pl[MOVEGEN_MAX];
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) sink += gen_placements(g, pl, NULL, MOVEGEN_MAX);
+}
+
+// Whole games from their seed to the top out, each piece turned and
+// shifted at random as tetris-sim's random policy does.
+static void bench_games(void *ctx, long iters, size_t *bytes) {
+    (void)bytes;
+    uint64_t *seed = ctx;
+    GameState g;
+    volatile int sink = 0;
+    for (long i = 0; i < iters; i++) {
+        Rng rng;
+        rng_seed(&rng, *seed);
+        game_init(&g, (*seed)++);
+        while (g.state == GAME_PLAY) {
+            if (rng_below(&rng, 8) == 0) game_apply(&g, ACT_HOLD);
+            int turns = rng_below(&rng, 4);
+            for (int k = 0; k < turns; k++) game_apply(&g, ACT_ROTATE);
+            int shift = (int)rng_below(&rng, g.width) - g.width / 2;
+            for (int k = 0; k < abs(shift); k++) game_apply(&g, shift < 0 ? ACT_LEFT : ACT_RIGHT);
+            game_apply(&g, ACT_HARD_DROP);
+        }
+        sink += g.pieces;
+    }
+}
+
+// --- Render Cases ---
+typedef enum { FRAME_FULL, FRAME_MOVE, FRAME_IDLE } FrameKind;
+
+typedef struct {
+    GameState g;
+    Screen s;
+    FrameKind kind;
+    long frame;
+} RenderCase;
+
+static void bench_render(void *ctx, long iters, size_t *bytes) {
+    RenderCase *c = ctx;
+    RenderInfo info = { 1000, 0, NULL, 0 };
+    for (long i = 0; i < iters; i++, c->frame++) {
+        if (c->kind == FRAME_FULL) c->s.full_redraw = 1;
+        else if (c->kind == FRAME_MOVE) game_apply(&c->g, (c->frame & 1) ? ACT_LEFT : ACT_RIGHT);
+        *bytes += render_frame(&c->s, &c->g, &info);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --json               print results as JSON\n"
+            "  --compare FILE       show the change against an earlier --json run\n"
+            "  --filter TEXT        run only the cases whose name contains TEXT\n"
+            "  --min-ms N           shortest timed batch (default 20)\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    Options o = { 0, 20e6, NULL, NULL, 0, 1 };
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--json")) o.json = 1;
+        else if (!strcmp(arg, "--filter") && val) { o.filter = val; i++; }
+        else if (!strcmp(arg, "--min-ms") && val) { o.min_ns = atof(val) * 1e6; i++; }
+        else if (!strcmp(arg, "--compare") && val) {
+            if (load_prev(&o, val) != 0) {
+                perror(val);
+                return 1;
+            }
+            i++;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!(o.min_ns > 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int counting = counters_open();
+    if (o.json) printf("{\"counters\": %s, \"results\": [", counting ? "true" : "false");
+    else if (!counting) printf("(hardware counters unavailable: %s)\n", strerror(errno));
+
+    static Probes probes;
+    setup_probes(&probes);
+    run(&o, "check_collision", bench_collision, &probes);
+    run(&o, "piece_rotate", bench_rotate, &probes);
+    run(&o, "game_ghost_y", bench_ghost, &probes);
+    run(&o, "game_copy", bench_copy, &probes.g);
+    for (int lines = 0; lines <= 4; lines++) {
+        static GameState g;
+        char name[32];
+        setup_lock(&g, lines);
+        GameState check = g;
+        game_apply(&check, ACT_HARD_DROP);
+        if (check.lines_cleared_total != lines) {
+            fprintf(stderr, "lock position for %d lines clears %d\n", lines, check.lines_cleared_total);
+            return 1;
+        }
+        snprintf(name, sizeof(name), "lock_%d_lines", lines);
+        run(&o, name, bench_lock, &g);
+    }
+    run(&o, "gen_placements", bench_movegen, &probes.g);
+
+    static const int sizes[][2] = { { 80, 24 }, { 200, 60 }, { 480, 135 } };
+    static const char *kinds[] = { "full", "move", "idle" };
+    for (int i = 0; i < 3; i++) {
+        for (int kind = FRAME_FULL; kind <= FRAME_IDLE; kind++) {
+            static RenderCase c;
+            char name[32];
+            setup_position(&c.g);
+            c.kind = kind;
+            c.frame = 0;
+            screen_init(&c.s);
+            screen_resize(&c.s, sizes[i][0], sizes[i][1]);
+            RenderInfo info = { 1000, 0, NULL, 0 };
+            render_frame(&c.s, &c.g, &info);
+            snprintf(name, sizeof(name), "render_%s_%dx%d", kinds[kind], sizes[i][0], sizes[i][1]);
+            run(&o, name, bench_render, &c);
+            screen_free(&c.s);
+        }
+    }
+
+    uint64_t seed = 1;
+    run(&o, "game_random", bench_games, &seed);
+
+    if (o.json) printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,467 @@
+#define _DEFAULT_SOURCE
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+
+// --- Tetromino Definitions ---
+// All four SRS rotation states of each piece. JLSTZ turn about the centre
+// of a 3x3 box, I about the centre of its 4x4 box, O not at all.
+const PieceShape PIECES[PIECE_TYPES][4] = {
+    { // I
+        { { {0,1}, {1,1}, {2,1}, {3,1} }, { 0xf, 0x0, 0x0, 0x0 }, { 1, 1, 1, 1 }, 0, 1, 4, 1 }, // 0
+        { { {2,0}, {2,1}, {2,2}, {2,3} }, { 0x1, 0x1, 0x1, 0x1 }, { 3, 0, 0, 0 }, 2, 0, 1, 4 }, // R
+        { { {0,2}, {1,2}, {2,2}, {3,2} }, { 0xf, 0x0, 0x0, 0x0 }, { 2, 2, 2, 2 }, 0, 2, 4, 1 }, // 2
+        { { {1,0}, {1,1}, {1,2}, {1,3} }, { 0x1, 0x1, 0x1, 0x1 }, { 3, 0, 0, 0 }, 1, 0, 1, 4 }, // L
+    },
+    { // J
+        { { {0,0}, {0,1}, {1,1}, {2,1} }, { 0x1, 0x7, 0x0, 0x0 }, { 1, 1, 1, 0 }, 0, 0, 3, 2 }, // 0
+        { { {1,0}, {2,0}, {1,1}, {1,2} }, { 0x3, 0x1, 0x1, 0x0 }, { 2, 0, 0, 0 }, 1, 0, 2, 3 }, // R
+        { { {0,1}, {1,1}, {2,1}, {2,2} }, { 0x7, 0x4, 0x0, 0x0 }, { 1, 1, 2, 0 }, 0, 1, 3, 2 }, // 2
+        { { {1,0}, {1,1}, {0,2}, {1,2} }, { 0x2, 0x2, 0x3, 0x0 }, { 2, 2, 0, 0 }, 0, 0, 2, 3 }, // L
+    },
+    { // L
+        { { {2,0}, {0,1}, {1,1}, {2,1} }, { 0x4, 0x7, 0x0, 0x0 }, { 1, 1, 1, 0 }, 0, 0, 3, 2 }, // 0
+        { { {1,0}, {1,1}, {1,2}, {2,2} }, { 0x1, 0x1, 0x3, 0x0 }, { 2, 2, 0, 0 }, 1, 0, 2, 3 }, // R
+        { { {0,1}, {1,1}, {2,1}, {0,2} }, { 0x7, 0x1, 0x0, 0x0 }, { 2, 1, 1, 0 }, 0, 1, 3, 2 }, // 2
+        { { {0,0}, {1,0}, {1,1}, {1,2} }, { 0x3, 0x2, 0x2, 0x0 }, { 0, 2, 0, 0 }, 0, 0, 2, 3 }, // L
+    },
+    { // O
+        { { {1,0}, {2,0}, {1,1}, {2,1} }, { 0x3, 0x3, 0x0, 0x0 }, { 1, 1, 0, 0 }, 1, 0, 2, 2 }, // 0
+        { { {1,0}, {2,0}, {1,1}, {2,1} }, { 0x3, 0x3, 0x0, 0x0 }, { 1, 1, 0, 0 }, 1, 0, 2, 2 }, // R
+        { { {1,0}, {2,0}, {1,1}, {2,1} }, { 0x3, 0x3, 0x0, 0x0 }, { 1, 1, 0, 0 }, 1, 0, 2, 2 }, // 2
+        { { {1,0}, {2,0}, {1,1}, {2,1} }, { 0x3, 0x3, 0x0, 0x0 }, { 1, 1, 0, 0 }, 1, 0, 2, 2 }, // L
+    },
+    { // S
+        { { {1,0}, {2,0}, {0,1}, {1,1} }, { 0x6, 0x3, 0x0, 0x0 }, { 1, 1, 0, 0 }, 0, 0, 3, 2 }, // 0
+        { { {1,0}, {1,1}, {2,1}, {2,2} }, { 0x1, 0x3, 0x2, 0x0 }, { 1, 2, 0, 0 }, 1, 0, 2, 3 }, // R
+        { { {1,1}, {2,1}, {0,2}, {1,2} }, { 0x6, 0x3, 0x0, 0x0 }, { 2, 2, 1, 0 }, 0, 1, 3, 2 }, // 2
+        { { {0,0}, {0,1}, {1,1}, {1,2} }, { 0x1, 0x3, 0x2, 0x0 }, { 1, 2, 0, 0 }, 0, 0, 2, 3 }, // L
+    },
+    { // T
+        { { {1,0}, {0,1}, {1,1}, {2,1} }, { 0x2, 0x7, 0x0, 0x0 }, { 1, 1, 1, 0 }, 0, 0, 3, 2 }, // 0
+        { { {1,0}, {1,1}, {2,1}, {1,2} }, { 0x1, 0x3, 0x1, 0x0 }, { 2, 1, 0, 0 }, 1, 0, 2, 3 }, // R
+        { { {0,1}, {1,1}, {2,1}, {1,2} }, { 0x7, 0x2, 0x0, 0x0 }, { 1, 2, 1, 0 }, 0, 1, 3, 2 }, // 2
+        { { {1,0}, {0,1}, {1,1}, {1,2} }, { 0x2, 0x3, 0x2, 0x0 }, { 1, 2, 0, 0 }, 0, 0, 2, 3 }, // L
+    },
+    { // Z
+        { { {0,0}, {1,0}, {1,1}, {2,1} }, { 0x3, 0x6, 0x0, 0x0 }, { 0, 1, 1, 0 }, 0, 0, 3, 2 }, // 0
+        { { {2,0}, {1,1}, {2,1}, {1,2} }, { 0x2, 0x3, 0x1, 0x0 }, { 2, 1, 0, 0 }, 1, 0, 2, 3 }, // R
+        { { {0,1}, {1,1}, {1,2}, {2,2} }, { 0x3, 0x6, 0x0, 0x0 }, { 1, 2, 2, 0 }, 0, 1, 3, 2 }, // 2
+        { { {1,0}, {0,1}, {1,1}, {0,2} }, { 0x2, 0x3, 0x1, 0x0 }, { 2, 1, 0, 0 }, 0, 0, 2, 3 }, // L
+    },
+};
+
+// y grows downwards here, unlike in the SRS tables.
+const Point KICKS[2][4][KICK_TESTS] = {
+    { // J L S T Z
+        { {0,0}, {-1,0}, {-1,-1}, {0,2}, {-1,2} },  // 0 -> R
+        { {0,0}, {1,0}, {1,1}, {0,-2}, {1,-2} },    // R -> 2
+        { {0,0}, {1,0}, {1,-1}, {0,2}, {1,2} },     // 2 -> L
+        { {0,0}, {-1,0}, {-1,1}, {0,-2}, {-1,-2} }, // L -> 0
+    },
+    { // I
+        { {0,0}, {-2,0}, {1,0}, {-2,1}, {1,-2} },   // 0 -> R
+        { {0,0}, {-1,0}, {2,0}, {-1,-2}, {2,1} },   // R -> 2
+        { {0,0}, {2,0}, {-1,0}, {2,-1}, {-1,2} },   // 2 -> L
+        { {0,0}, {1,0}, {-2,0}, {1,2}, {-2,-1} },   // L -> 0
+    },
+};
+
+// --- Bag System ---
+static void shuffle_bag(Bag *b) {
+    b->seed = b->rng.state;
+    for (int i = 0; i < 7; i++) b->pieces[i] = i;
+    for (int i = 6; i > 0; i--) {
+        int j = rng_below(&b->rng, i + 1);
+        int temp = b->pieces[i];
+        b->pieces[i] = b->pieces[j];
+        b->pieces[j] = temp;
+    }
+    b->head = 0;
+}
+
+static Tetromino get_from_bag(GameState *g) {
+    if (g->bag.head >= 7) {
+        shuffle_bag(&g->bag);
+    }
+    Tetromino p = { (uint8_t)g->bag.pieces[g->bag.head++], 0 };
+    return p;
+}
+
+static Tetromino pop_next_piece(GameState *g) {
+    Tetromino p = g->next_queue[0];
+    for (int i = 0; i < NEXT_COUNT - 1; i++) g->next_queue[i] = g->next_queue[i + 1];
+    g->next_queue[NEXT_COUNT - 1] = get_from_bag(g);
+    return p;
+}
+
+// --- Hashing ---
+// Zobrist hashing by rows: every (row index, row contents) pair has its
+// own pseudo-random key, and board_hash is the XOR of the keys of the
+// non-empty rows. Changing a row costs two keys, which a mixer computes
+// rather than a table storing them.
+#define HASH_SALT 0x7E7215B0A2D5EEDULL
+
+static inline uint64_t row_key(int y, uint16_t row) {
+    return row ? rng_mix(HASH_SALT ^ ((uint64_t)y << 16 | row)) : 0;
+}
+
+void game_rehash(GameState *g) {
+    g->board_hash = 0;
+    for (int y = 0; y < g->height; y++) g->board_hash ^= row_key(y, g->rows[y]);
+}
+
+// The rest of the state is a few small fields, folded in on demand.
+uint64_t game_hash(const GameState *g) {
+    const Tetromino *p = &g->current_piece;
+    uint64_t piece = p->type | p->rot << 3 | (uint8_t)g->piece_x << 5 | (uint8_t)g->piece_y << 13;
+    uint64_t k = rng_mix(HASH_SALT + (piece | (uint64_t)(g->hold_idx + 1) << 21 |
+                                      (uint64_t)g->hold_locked << 25 | (uint64_t)g->state << 26));
+    for (int i = 0; i < NEXT_COUNT; i++) k = rng_mix(k ^ g->next_queue[i].type);
+    for (int i = g->bag.head; i < 7; i++) k = rng_mix(k ^ (uint64_t)(g->bag.pieces[i] + 8));
+    return g->board_hash ^ k;
+}
+
+// --- Game Logic ---
+static void spawn_piece(GameState *g) {
+    g->current_piece = pop_next_piece(g);
+    g->piece_x = SPAWN_X(g->width);
+    g->piece_y = 0;
+    g->hold_locked = 0;
+
+    if (check_collision(g, &g->current_piece, g->piece_x, g->piece_y)) {
+        g->state = GAME_OVER;
+    }
+}
+
+void game_reset(GameState *g) {
+    memset(g->rows, 0, sizeof(g->rows));
+    memset(g->color, 0, g->height * sizeof(g->color[0])); // Rows past the board are never read
+    memset(g->col_height, 0, sizeof(g->col_height));
+    g->board_hash = 0;
+
+    g->score = 0;
+    g->lines_cleared_total = 0;
+    g->level = 1;
+    g->pieces = 0;
+    g->state = GAME_PLAY;
+    g->hold_idx = -1;
+    g->hold_locked = 0;
+
+    shuffle_bag(&g->bag);
+    for (int i = 0; i < NEXT_COUNT; i++) g->next_queue[i] = get_from_bag(g);
+
+    spawn_piece(g);
+}
+
+int game_init_sized(GameState *g, uint64_t seed, int width, int height) {
+    if (width < BOARD_MIN_SIZE || width > BOARD_MAX_WIDTH || height < BOARD_MIN_SIZE || height > BOARD_MAX_HEIGHT) {
+        return -1;
+    }
+    g->width = (uint8_t)width;
+    g->height = (uint8_t)height;
+    rng_seed(&g->bag.rng, seed);
+    game_reset(g);
+    return 0;
+}
+
+void game_init(GameState *g, uint64_t seed) {
+    game_init_sized(g, seed, BOARD_WIDTH, BOARD_HEIGHT);
+}
+
+void game_copy(GameState *g, const GameState *src) {
+    memcpy(g, src, offsetof(GameState, color) + src->height * sizeof(src->color[0]));
+}
+
+static inline int shape_collides(const GameState *g, const PieceShape *m, int x, int y) {
+    int col = x + m->left;
+    int row = y + m->top;
+    if (col < 0 || col + m->width > g->width || row + m->height > g->height) return 1;
+
+    for (int r = 0; r < m->height; r++) {
+        if (row + r >= 0 && (g->rows[row + r] & (m->rows[r] << col))) return 1;
+    }
+    return 0;
+}
+
+int check_collision(const GameState *g, const Tetromino *p, int x, int y) {
+    return shape_collides(g, PIECE_SHAPE(p), x, y);
+}
+
+// --- Board Kernels ---
+// Loops over the board written for a size W x H and expanded per size
+// through BOARD_SPECIALIZE().
+
+// Removes the full rows among [first, last], the only rows a lock can
+// fill, in one pass: rows below the lowest full one stay, each row above
+// it moves once, and the empty rows over the stack are never touched.
+static inline __attribute__((always_inline)) int clear_rows(GameState *g, int first, int last, int W, int H) {
+    int lowest = -1;
+    for (int y = last; y >= first; y--) {
+        if (g->rows[y] == FULL_ROW(W)) {
+            lowest = y;
+            break;
+        }
+    }
+    if (lowest < 0) return 0;
+
+    int stack_h = 0;
+    for (int x = 0; x < W; x++) {
+        if (g->col_height[x] > stack_h) stack_h = g->col_height[x];
+    }
+    int top = H - stack_h;
+
+    int dst = lowest;
+    for (int src = lowest; src >= top; src--) {
+        if (g->rows[src] == FULL_ROW(W)) continue;
+        if (dst != src) {
+            g->board_hash ^= row_key(dst, g->rows[dst]) ^ row_key(dst, g->rows[src]);
+            g->rows[dst] = g->rows[src];
+            memcpy(g->color[dst], g->color[src], sizeof(g->color[0]));
+        }
+        dst--;
+    }
+    int lines = dst - top + 1;
+    for (; dst >= top; dst--) {
+        g->board_hash ^= row_key(dst, g->rows[dst]);
+        g->rows[dst] = 0;
+        memset(g->color[dst], 0, sizeof(g->color[0]));
+    }
+    return lines;
+}
+
+static inline __attribute__((always_inline)) void heights_of(GameState *g, int W, int H) {
+    uint16_t seen = 0;
+    memset(g->col_height, 0, sizeof(g->col_height));
+    for (int y = 0; y < H && seen != FULL_ROW(W); y++) {
+        for (unsigned fresh = g->rows[y] & ~seen; fresh; fresh &= fresh - 1) {
+            g->col_height[__builtin_ctz(fresh)] = H - y;
+        }
+        seen |= g->rows[y];
+    }
+}
+
+void game_update_heights(GameState *g) {
+    BOARD_SPECIALIZE(g->width, g->height, heights_of, g);
+}
+
+static void lock_piece(GameState *g) {
+    const Tetromino *p = &g->current_piece;
+    const PieceShape *shape = PIECE_SHAPE(p);
+    int first = g->piece_y + shape->top;
+    int last = first + shape->height - 1;
+    if (first < 0) first = 0;
+    if (last >= g->height) last = g->height - 1;
+
+    for (int y = first; y <= last; y++) g->board_hash ^= row_key(y, g->rows[y]);
+    for (int i = 0; i < 4; i++) {
+        int bx = g->piece_x + shape->cells[i].x;
+        int by = g->piece_y + shape->cells[i].y;
+        if (by >= 0 && by < g->height && bx >= 0 && bx < g->width) {
+            g->rows[by] |= 1u << bx;
+            g->color[by][bx] = PIECE_COLOR(p->type);
+            if (g->col_height[bx] < g->height - by) g->col_height[bx] = g->height - by;
+        }
+    }
+    for (int y = first; y <= last; y++) g->board_hash ^= row_key(y, g->rows[y]);
+    g->pieces++;
+
+    int lines = BOARD_SPECIALIZE(g->width, g->height, clear_rows, g, first, last);
+
+    if (lines > 0) {
+        game_update_heights(g);
+        g->lines_cleared_total += lines;
+        static const int points[] = {0, 100, 300, 500, 800};
+        g->score += points[lines] * g->level;
+        g->level = 1 + (g->lines_cleared_total / 10);
+    }
+
+    spawn_piece(g);
+}
+
+static void hold_piece_action(GameState *g) {
+    if (g->hold_idx == -1) {
+        g->hold_idx = g->current_piece.type;
+        spawn_piece(g); // Spawns next from queue
+    } else {
+        int temp = g->hold_idx;
+        g->hold_idx = g->current_piece.type;
+        g->current_piece.type = (uint8_t)temp;
+        g->current_piece.rot = 0;
+        g->piece_x = SPAWN_X(g->width);
+        g->piece_y = 0;
+    }
+    g->hold_locked = 1;
+}
+
+int piece_rotate(const GameState *g, Tetromino *p, int *x, int *y) {
+    if (p->type == PIECE_O) return 0;
+
+    Tetromino turned = { p->type, (uint8_t)((p->rot + 1) & 3) };
+    const PieceShape *m = PIECE_SHAPE(&turned);
+    const Point *kick = KICKS[p->type == PIECE_I][p->rot];
+    for (int k = 0; k < KICK_TESTS; k++) {
+        if (!shape_collides(g, m, *x + kick[k].x, *y + kick[k].y)) {
+            *p = turned;
+            *x += kick[k].x;
+            *y += kick[k].y;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int rotate_piece(GameState *g) {
+    return piece_rotate(g, &g->current_piece, &g->piece_x, &g->piece_y);
+}
+
+static int shift_piece(GameState *g, int dx, int dy) {
+    if (check_collision(g, &g->current_piece, g->piece_x + dx, g->piece_y + dy)) return 0;
+    g->piece_x += dx;
+    g->piece_y += dy;
+    return 1;
+}
+
+// Straight from the column heights while the piece is above the surface
+// of every column it covers. Only a piece tucked under an overhang has to
+// probe its way down.
+int game_ghost_y(const GameState *g) {
+    const PieceShape *m = PIECE_SHAPE(&g->current_piece);
+    int land = g->height;
+    for (int c = 0; c < m->width; c++) {
+        int surface = g->height - g->col_height[g->piece_x + m->left + c]; // Topmost filled row
+        if (g->piece_y + m->bottom[c] >= surface) goto probe;
+        if (surface - 1 - m->bottom[c] < land) land = surface - 1 - m->bottom[c];
+    }
+    return land;
+
+probe:;
+    int ghost_y = g->piece_y;
+    while (!shape_collides(g, m, g->piece_x, ghost_y + 1)) {
+        ghost_y++;
+    }
+    return ghost_y;
+}
+
+int game_apply(GameState *g, Action a) {
+    if (g->state != GAME_PLAY) return 0;
+
+    switch (a) {
+        case ACT_LEFT: return shift_piece(g, -1, 0);
+        case ACT_RIGHT: return shift_piece(g, 1, 0);
+        case ACT_SOFT_DROP: return shift_piece(g, 0, 1);
+        case ACT_ROTATE: return rotate_piece(g);
+        case ACT_HARD_DROP:
+            g->piece_y = game_ghost_y(g);
+            lock_piece(g);
+            return 1;
+        case ACT_HOLD:
+            if (g->hold_locked) return 0;
+            hold_piece_action(g);
+            return 1;
+        default: return 0;
+    }
+}
+
+int game_tick(GameState *g) {
+    if (g->state != GAME_PLAY) return 0;
+
+    if (!shift_piece(g, 0, 1)) lock_piece(g);
+    return 1;
+}
+
+int game_add_garbage(GameState *g, int lines, int hole) {
+    if (g->state != GAME_PLAY || lines <= 0 || hole < 0 || hole >= g->width) return 0;
+    if (lines > g->height) lines = g->height;
+    int keep = g->height - lines, topped = 0;
+    for (int y = 0; y < lines; y++) topped |= g->rows[y] != 0;
+
+    memmove(g->rows, g->rows + lines, keep * sizeof(g->rows[0]));
+    memmove(g->color, g->color + lines, keep * sizeof(g->color[0]));
+    uint16_t row = FULL_ROW(g->width) & ~(1u << hole);
+    for (int y = keep; y < g->height; y++) {
+        g->rows[y] = row;
+        memset(g->color[y], PIECE_COLOR(PIECE_O), g->width);
+        g->color[y][hole] = 0;
+    }
+    game_update_heights(g);
+    game_rehash(g);
+
+    if (topped || check_collision(g, &g->current_piece, g->piece_x, g->piece_y)) g->state = GAME_OVER;
+    return 1;
+}
+
+// --- Snapshots ---
+void game_snapshot(const GameState *g, GameSnapshot *s, uint16_t *tail) {
+    s->bag_seed = g->bag.seed;
+    memcpy(s->rows, g->rows, sizeof(s->rows)); // Zero past a short board
+    if (g->height > BOARD_HEIGHT) memcpy(tail, g->rows + BOARD_HEIGHT, SNAPSHOT_TAIL(g->height) * sizeof(*tail));
+    s->score = g->score;
+    s->lines = g->lines_cleared_total;
+    s->pieces = g->pieces;
+    s->type = g->current_piece.type;
+    s->rot = g->current_piece.rot;
+    s->x = (uint32_t)(g->piece_x + 2);
+    s->y = (uint32_t)(g->piece_y + 8);
+    s->hold = (uint32_t)(g->hold_idx + 1);
+    s->hold_locked = g->hold_locked != 0;
+    s->over = g->state == GAME_OVER;
+    s->bag_head = (uint32_t)g->bag.head;
+    uint32_t next = 0;
+    for (int i = 0; i < NEXT_COUNT; i++) next |= (uint32_t)g->next_queue[i].type << (3 * i);
+    s->next = next;
+}
+
+// The bag comes back by shuffling again from its seed, which also leaves
+// the generator where it was.
+void game_restore(GameState *g, const GameSnapshot *s, const uint16_t *tail) {
+    for (int y = 0; y < g->height; y++) {
+        uint16_t row = SNAPSHOT_ROW(s, tail, y);
+        if (!row) {
+            if (g->rows[y]) memset(g->color[y], 0, sizeof(g->color[y]));
+        } else if (row != g->rows[y]) {
+            for (int x = 0; x < g->width; x++) {
+                if (!(row >> x & 1)) g->color[y][x] = 0;
+                else if (!(g->rows[y] >> x & 1)) g->color[y][x] = PIECE_COLOR(PIECE_O);
+            }
+        }
+        g->rows[y] = row;
+    }
+    game_update_heights(g);
+    game_rehash(g);
+
+    g->bag.rng.state = s->bag_seed;
+    shuffle_bag(&g->bag);
+    g->bag.head = s->bag_head;
+    for (int i = 0; i < NEXT_COUNT; i++) {
+        g->next_queue[i].type = (uint8_t)(s->next >> (3 * i) & 7);
+        g->next_queue[i].rot = 0;
+    }
+
+    g->current_piece.type = s->type;
+    g->current_piece.rot = s->rot;
+    g->piece_x = (int)s->x - 2;
+    g->piece_y = (int)s->y - 8;
+    g->hold_idx = (int)s->hold - 1;
+    g->hold_locked = s->hold_locked;
+    g->score = s->score;
+    g->lines_cleared_total = s->lines;
+    g->level = 1 + s->lines / 10;
+    g->pieces = s->pieces;
+    g->state = s->over ? GAME_OVER : GAME_PLAY;
+}
+
+// 1000 ms * 0.9^(level - 1), floored at 50 ms from level 30 on.
+static const int16_t GRAVITY_MS[] = {
+    1000, 900, 810, 729, 656, 590, 531, 478, 430, 387,
+    348, 313, 282, 254, 228, 205, 185, 166, 150, 135,
+    121, 109, 98, 88, 79, 71, 64, 58, 52, 50,
+};
+#define GRAVITY_LEVELS (int)(sizeof(GRAVITY_MS) / sizeof(GRAVITY_MS[0]))
+
+int game_drop_interval_ms(const GameState *g) {
+    int level = g->level < 1 ? 1 : g->level;
+    return level > GRAVITY_LEVELS ? GRAVITY_MS[GRAVITY_LEVELS - 1] : GRAVITY_MS[level - 1];
+}
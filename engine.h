@@ -0,0 +1,197 @@
+#ifndef TETRIS_ENGINE_H
+#define TETRIS_ENGINE_H
+
+#include <stdint.h>
+
+#include "rng.h"
+
+// --- Constants & Config ---
+// Every game picks its board size (GameState.width and .height) within
+// the limits below. The standard board and the tall one with a buffer zone
+// get kernels compiled for their size; other sizes run generic code.
+#define BOARD_WIDTH 10  // Standard board
+#define BOARD_HEIGHT 20
+#define BOARD_TALL_HEIGHT 40
+#define BOARD_MIN_SIZE 4 // Both ways, so every piece spawns
+#define BOARD_MAX_WIDTH 14 // Rows plus both walls fill a 16-bit lane in eval.c
+#define BOARD_MAX_HEIGHT 40
+#define NEXT_COUNT 3 // Pieces visible in the preview queue
+#define SPAWN_X(width) ((width) / 2 - 2) // piece_x of a new piece; piece_y is 0
+
+// One occupancy mask per row, bit x set when column x is filled.
+#define FULL_ROW(width) ((uint16_t)((1u << (width)) - 1))
+_Static_assert(BOARD_MAX_WIDTH <= 16, "board rows are 16-bit masks");
+_Static_assert(BOARD_MAX_HEIGHT <= 255, "column heights are 8-bit");
+
+// Calls fn(args..., W, H) with the size as constants for the standard and
+// tall boards, so an always_inline kernel is compiled once per size, and
+// with the run-time size otherwise.
+#define BOARD_SPECIALIZE(w, h, fn, ...)                                        \
+    ((w) == BOARD_WIDTH && (h) == BOARD_HEIGHT                                 \
+         ? fn(__VA_ARGS__, BOARD_WIDTH, BOARD_HEIGHT)                          \
+     : (w) == BOARD_WIDTH && (h) == BOARD_TALL_HEIGHT                          \
+         ? fn(__VA_ARGS__, BOARD_WIDTH, BOARD_TALL_HEIGHT)                     \
+         : fn(__VA_ARGS__, (w), (h)))
+
+// --- Game Structures ---
+typedef struct {
+    int8_t x, y;
+} Point;
+
+enum { PIECE_I, PIECE_J, PIECE_L, PIECE_O, PIECE_S, PIECE_T, PIECE_Z, PIECE_TYPES };
+
+// One rotation state of a piece, placed in its 4x4 box as in SRS.
+typedef struct {
+    Point cells[4];
+    uint16_t rows[4]; // Row masks from `top` down, bit 0 = column `left`
+    int8_t bottom[4]; // Lowest cell's row in each column, from `left`
+    int8_t left, top, width, height;
+} PieceShape;
+
+// A piece is a type and a rotation; its geometry lives in PIECES.
+typedef struct {
+    uint8_t type; // PIECE_I .. PIECE_Z
+    uint8_t rot;  // 0-3, clockwise from the spawn state
+} Tetromino;
+
+// 7-bag randomizer. The generator lives in the bag, so a seed fixes the
+// whole piece sequence of one game.
+typedef struct {
+    int pieces[7];
+    int head;
+    Rng rng;
+    uint64_t seed; // rng.state before this bag was shuffled
+} Bag;
+
+typedef enum {
+    GAME_PLAY = 0,
+    GAME_OVER = 1
+} GamePhase;
+
+typedef enum {
+    ACT_NONE = 0,
+    ACT_LEFT,
+    ACT_RIGHT,
+    ACT_SOFT_DROP,
+    ACT_ROTATE,
+    ACT_HARD_DROP,
+    ACT_HOLD,
+    ACT_COUNT
+} Action;
+
+// Everything one game needs. Games share nothing, so any number of them
+// can run side by side in one process.
+typedef struct {
+    uint8_t width, height; // Board size, fixed for the game
+    uint16_t rows[BOARD_MAX_HEIGHT];
+    uint8_t col_height[BOARD_MAX_WIDTH]; // Rows up to the top filled cell, 0 = empty
+    uint64_t board_hash;                 // Zobrist hash of rows, kept up to date
+
+    Bag bag;
+    Tetromino next_queue[NEXT_COUNT];
+
+    // Hold System
+    int hold_idx; // -1 means empty
+    int hold_locked;
+
+    Tetromino current_piece;
+    int piece_x, piece_y;
+
+    int score;
+    int lines_cleared_total;
+    int level;
+    int pieces; // Pieces locked so far
+    GamePhase state;
+
+    // Last, so game_copy() can skip the rows a small board does not use
+    uint8_t color[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH]; // PIECE_COLOR() per filled cell
+} GameState;
+
+// A whole game in 64 pointer-free bytes: plain assignment copies it, so
+// rollouts and undo can keep as many as they like. Colors are left out;
+// the bag is its seed and how far it has been drawn. The board size is
+// left to whoever keeps the snapshot, and a board taller than
+// BOARD_HEIGHT keeps the rows past it in a tail of SNAPSHOT_TAIL(height)
+// more, so the standard board pays nothing for tall ones.
+typedef struct {
+    uint64_t bag_seed;
+    uint32_t type : 3, rot : 2;
+    uint32_t x : 4;       // piece_x + 2
+    uint32_t y : 6;       // piece_y + 8
+    uint32_t hold : 3;    // hold_idx + 1
+    uint32_t hold_locked : 1, over : 1;
+    uint32_t bag_head : 3;
+    uint32_t next : 9;    // next_queue types, 3 bits each
+    int32_t score, lines, pieces;
+    uint16_t rows[BOARD_HEIGHT]; // The first `height`, up to BOARD_HEIGHT
+} GameSnapshot;
+
+#define SNAPSHOT_TAIL(height) ((height) > BOARD_HEIGHT ? (height) - BOARD_HEIGHT : 0)
+#define SNAPSHOT_TAIL_MAX SNAPSHOT_TAIL(BOARD_MAX_HEIGHT)
+// Row y of a snapshot and its tail, as an lvalue.
+#define SNAPSHOT_ROW(s, tail, y) (*((y) < BOARD_HEIGHT ? &(s)->rows[(y)] : &(tail)[(y) - BOARD_HEIGHT]))
+
+_Static_assert(NEXT_COUNT * 3 <= 9, "the preview must fit in GameSnapshot.next");
+// Every piece rotation has a cell in column 2 or left of it and one in
+// column 1 or right of it, so piece_x stays within -2 and width - 2
+_Static_assert(BOARD_MAX_WIDTH <= 15 && BOARD_MAX_HEIGHT <= 55, "piece positions must fit in GameSnapshot");
+_Static_assert(sizeof(GameSnapshot) <= 64, "a standard board snapshots into one cache line");
+
+extern const PieceShape PIECES[PIECE_TYPES][4];
+#define PIECE_SHAPE(p) (&PIECES[(p)->type][(p)->rot])
+// Value a locked cell of this type gets in GameState.color (0 is empty).
+#define PIECE_COLOR(type) ((type) + 1)
+
+// SRS wall kicks for a clockwise turn out of each rotation state, tried in
+// order: [0] for J L S T Z, [1] for I. y grows downwards.
+#define KICK_TESTS 5
+extern const Point KICKS[2][4][KICK_TESTS];
+
+// --- Engine API ---
+// Seeds the bag and starts a fresh game on the standard board. Equal seeds
+// give equal piece sequences.
+void game_init(GameState *g, uint64_t seed);
+// The same on a width x height board. Returns -1, leaving g alone, when
+// the size is outside BOARD_MIN_SIZE and the maximums.
+int game_init_sized(GameState *g, uint64_t seed, int width, int height);
+// g = *src without the color rows past the board, for search code that
+// copies games in its inner loop.
+void game_copy(GameState *g, const GameState *src);
+// Clears the board and score, keeping the bag's random stream.
+void game_reset(GameState *g);
+// Applies one player action. Returns 1 when the state changed.
+int game_apply(GameState *g, Action a);
+// One gravity step: moves the piece down or locks it. Returns 1 when the
+// state changed.
+int game_tick(GameState *g);
+// Pushes the board up by `lines` rows of garbage, full but for column
+// `hole`, colored as PIECE_O. The game is over when filled rows go past the
+// top or the current piece no longer fits. Returns 1 when the state changed;
+// nothing changes for a hole outside [0, width).
+int game_add_garbage(GameState *g, int lines, int hole);
+
+int check_collision(const GameState *g, const Tetromino *p, int x, int y);
+// Turns p clockwise at (*x, *y), taking the first SRS kick that fits.
+// Returns 1 and updates p, x and y when it turned.
+int piece_rotate(const GameState *g, Tetromino *p, int *x, int *y);
+// Row the current piece would land on if hard dropped.
+int game_ghost_y(const GameState *g);
+// Rebuild col_height and board_hash from rows, for callers that edit rows
+// directly.
+void game_update_heights(GameState *g);
+void game_rehash(GameState *g);
+// Hash of everything that decides how the game goes on: the board, the
+// piece and where it is, hold, the preview and what is left of the bag.
+uint64_t game_hash(const GameState *g);
+// Copy the state into *s, or back out of it. `tail` holds the rows past
+// BOARD_HEIGHT of a taller board and may be NULL on others. g must be of
+// the board size the snapshot was taken on; game_init_sized() one first
+// when it is not. game_restore() derives the level, column heights and
+// hash; cells keep their color where the board was already filled and
+// show as PIECE_O elsewhere.
+void game_snapshot(const GameState *g, GameSnapshot *s, uint16_t *tail);
+void game_restore(GameState *g, const GameSnapshot *s, const uint16_t *tail);
+// Milliseconds between gravity steps at the current level.
+int game_drop_interval_ms(const GameState *g);
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eval.h"
+
+// Kernels take the board size W x H last and are expanded per size through
+// BOARD_SPECIALIZE().
+
+// Row transitions count the walls as filled: bit 0 and bit W + 1 of a row
+// shifted left by one.
+#define WALLS(W) (1u | 1u << ((W) + 1))
+#define EDGES(W) ((1u << ((W) + 1)) - 1) // Cell pairs, walls included
+_Static_assert(BOARD_MAX_WIDTH + 2 <= 16, "rows with both walls must fit in a 16-bit lane");
+
+// Bits per column height counter
+#define HEIGHT_BITS(H) ((H) < 16 ? 4 : (H) < 32 ? 5 : (H) < 64 ? 6 : 8)
+#define MAX_HEIGHT_BITS HEIGHT_BITS(BOARD_MAX_HEIGHT)
+
+// --- Scalar ---
+static inline __attribute__((always_inline)) void features_of(const uint16_t *rows, BoardFeatures *f, int W, int H) {
+    int col[BOARD_MAX_WIDTH] = { 0 };
+    int holes = 0, transitions = 0;
+    unsigned covered = 0;
+    for (int y = 0; y < H; y++) {
+        unsigned row = rows[y];
+        holes += __builtin_popcount(covered & ~row);
+        for (unsigned fresh = row & ~covered; fresh; fresh &= fresh - 1) {
+            col[__builtin_ctz(fresh)] = H - y;
+        }
+        covered |= row;
+        unsigned r = row << 1 | WALLS(W);
+        transitions += __builtin_popcount((r ^ r >> 1) & EDGES(W));
+    }
+
+    int height = 0, bumpiness = 0, wells = 0;
+    for (int x = 0; x < W; x++) {
+        int left = x > 0 ? col[x - 1] : H;
+        int right = x + 1 < W ? col[x + 1] : H;
+        int low = left < right ? left : right;
+        height += col[x];
+        if (x > 0) bumpiness += abs(col[x] - left);
+        if (low > col[x]) wells += low - col[x];
+    }
+    f->height = (int16_t)height;
+    f->holes = (int16_t)holes;
+    f->transitions = (int16_t)transitions;
+    f->bumpiness = (int16_t)bumpiness;
+    f->wells = (int16_t)wells;
+}
+
+void board_features(const uint16_t *rows, int width, int height, BoardFeatures *f) {
+    BOARD_SPECIALIZE(width, height, features_of, rows, f);
+}
+
+static void blocks_scalar(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height) {
+    for (int b = 0; b < blocks; b++) {
+        for (int i = 0; i < EVAL_LANES; i++) {
+            uint16_t rows[BOARD_MAX_HEIGHT];
+            BoardFeatures f;
+            for (int y = 0; y < height; y++) rows[y] = in[b].rows[y][i];
+            board_features(rows, width, height, &f);
+            out[b].height[i] = f.height;
+            out[b].holes[i] = f.holes;
+            out[b].transitions[i] = f.transitions;
+            out[b].bumpiness[i] = f.bumpiness;
+            out[b].wells[i] = f.wells;
+        }
+    }
+}
+
+// --- Vector ---
+// Written once with GCC vector types and compiled per instruction set
+// below: one 256-bit register per block row under AVX2, two under SSE2.
+// Column heights are bit-sliced: counter bit k of column x is bit x of
+// plane[k], and every row adds the columns covered so far to it.
+typedef uint16_t vu16 __attribute__((vector_size(2 * EVAL_LANES)));
+typedef int16_t vs16 __attribute__((vector_size(2 * EVAL_LANES)));
+
+// Helpers take pointers: vector arguments would tie them to one ABI.
+static inline __attribute__((always_inline)) void popcount16(vu16 *v) {
+    vu16 x = *v;
+    x = x - (x >> 1 & 0x5555);
+    x = (x & 0x3333) + (x >> 2 & 0x3333);
+    x = (x + (x >> 4)) & 0x0f0f;
+    *v = (x + (x >> 8)) & 0x1f;
+}
+
+static inline __attribute__((always_inline)) void block_features(const BoardBlock *in, FeatureBlock *out, int W, int H) {
+    vu16 covered = { 0 }, holes = { 0 }, transitions = { 0 };
+    vu16 plane[MAX_HEIGHT_BITS] = { { 0 } };
+    for (int y = 0; y < H; y++) {
+        vu16 row;
+        memcpy(&row, in->rows[y], sizeof(row));
+        vu16 hidden = covered & ~row;
+        popcount16(&hidden);
+        holes += hidden;
+        covered |= row;
+        vu16 r = row << 1 | (uint16_t)WALLS(W);
+        vu16 changes = (r ^ r >> 1) & (uint16_t)EDGES(W);
+        popcount16(&changes);
+        transitions += changes;
+        vu16 carry = covered;
+        for (int k = 0; k < HEIGHT_BITS(H); k++) {
+            vu16 next = plane[k] & carry;
+            plane[k] ^= carry;
+            carry = next;
+        }
+    }
+
+    vs16 col[BOARD_MAX_WIDTH];
+    for (int x = 0; x < W; x++) {
+        vu16 h = { 0 };
+        for (int k = 0; k < HEIGHT_BITS(H); k++) h |= (plane[k] >> x & 1) << k;
+        col[x] = (vs16)h;
+    }
+    vs16 height = { 0 }, bumpiness = { 0 }, wells = { 0 };
+    vs16 wall = { 0 };
+    wall += (int16_t)H;
+    for (int x = 0; x < W; x++) {
+        vs16 left = x > 0 ? col[x - 1] : wall;
+        vs16 right = x + 1 < W ? col[x + 1] : wall;
+        height += col[x];
+        if (x > 0) {
+            vs16 d = col[x] - left;
+            bumpiness += (d ^ d >> 15) - (d >> 15);
+        }
+        vs16 less = left < right;
+        vs16 depth = ((left & less) | (right & ~less)) - col[x];
+        wells += depth & (depth > 0);
+    }
+
+    memcpy(out->height, &height, sizeof(height));
+    memcpy(out->holes, &holes, sizeof(holes));
+    memcpy(out->transitions, &transitions, sizeof(transitions));
+    memcpy(out->bumpiness, &bumpiness, sizeof(bumpiness));
+    memcpy(out->wells, &wells, sizeof(wells));
+}
+
+static inline __attribute__((always_inline)) void blocks_of(const BoardBlock *in, FeatureBlock *out, int blocks,
+                                                            int W, int H) {
+    for (int b = 0; b < blocks; b++) block_features(&in[b], &out[b], W, H);
+}
+
+static void blocks_vector(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height) {
+    BOARD_SPECIALIZE(width, height, blocks_of, in, out, blocks);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void blocks_avx2(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height) {
+    BOARD_SPECIALIZE(width, height, blocks_of, in, out, blocks);
+}
+#endif
+
+// --- Dispatch ---
+typedef void (*BlocksFn)(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height);
+
+static const struct {
+    const char *name;
+    BlocksFn fn;
+} KERNELS[EVAL_KERNELS] = {
+    [EVAL_SCALAR] = { "scalar", blocks_scalar },
+#if defined(__x86_64__) || defined(__i386__)
+    [EVAL_SSE2] = { "sse2", blocks_vector },
+    [EVAL_AVX2] = { "avx2", blocks_avx2 },
+#endif
+};
+
+static _Atomic int current = -1; // EvalKernel in use, -1 before the first call
+
+static int supported(EvalKernel k) {
+    if (k < 0 || k >= EVAL_KERNELS || !KERNELS[k].fn) return 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (k == EVAL_SSE2) return __builtin_cpu_supports("sse2");
+    if (k == EVAL_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+    return 1;
+}
+
+EvalKernel eval_kernel(void) {
+    int k = atomic_load_explicit(&current, memory_order_relaxed);
+    if (k < 0) {
+        k = EVAL_KERNELS - 1;
+        while (!supported(k)) k--;
+        atomic_store_explicit(&current, k, memory_order_relaxed);
+    }
+    return k;
+}
+
+int eval_use_kernel(EvalKernel k) {
+    if (!supported(k)) return 0;
+    atomic_store_explicit(&current, k, memory_order_relaxed);
+    return 1;
+}
+
+const char *eval_kernel_name(EvalKernel k) {
+    return k >= 0 && k < EVAL_KERNELS && KERNELS[k].name ? KERNELS[k].name : "none";
+}
+
+void eval_blocks(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height) {
+    KERNELS[eval_kernel()].fn(in, out, blocks, width, height);
+}
@@ -0,0 +1,54 @@
+#ifndef TETRIS_EVAL_H
+#define TETRIS_EVAL_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// Board features for search, scored many boards at a time. Boards go in
+// blocks of EVAL_LANES in structure-of-arrays layout: row y of every board
+// is one 16-bit lane in a single vector, so a row step handles the whole
+// block. All features are integers, so every kernel gives equal results.
+
+typedef struct {
+    int16_t height;      // Sum of column heights
+    int16_t holes;       // Empty cells with a filled cell above
+    int16_t transitions; // Filled/empty changes along rows, walls filled
+    int16_t bumpiness;   // Height steps between neighbouring columns
+    int16_t wells;       // Depth of columns lower than both neighbours
+} BoardFeatures;
+
+#define EVAL_LANES 16
+
+typedef struct {
+    uint16_t rows[BOARD_MAX_HEIGHT][EVAL_LANES]; // rows[y][i]: row y of board i; the first `height` used
+} BoardBlock;
+
+typedef struct {
+    int16_t height[EVAL_LANES];
+    int16_t holes[EVAL_LANES];
+    int16_t transitions[EVAL_LANES];
+    int16_t bumpiness[EVAL_LANES];
+    int16_t wells[EVAL_LANES];
+} FeatureBlock;
+
+typedef enum {
+    EVAL_SCALAR,
+    EVAL_SSE2,
+    EVAL_AVX2,
+    EVAL_KERNELS
+} EvalKernel;
+
+// One width x height board, scalar.
+void board_features(const uint16_t *rows, int width, int height, BoardFeatures *f);
+// Features of every lane of `blocks` blocks of width x height boards.
+// Unused lanes may hold anything.
+void eval_blocks(const BoardBlock *in, FeatureBlock *out, int blocks, int width, int height);
+
+// eval_blocks() starts on the widest kernel the CPU runs. Returns 0 when
+// `k` is not available here.
+int eval_use_kernel(EvalKernel k);
+EvalKernel eval_kernel(void);
+const char *eval_kernel_name(EvalKernel k);
+
+#endif
@@ -0,0 +1,175 @@
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "feed.h"
+
+#define FEED_MAGIC 0x3130444545465454ull // "TTFEED01" on little-endian
+
+_Static_assert((FEED_SLOTS & (FEED_SLOTS - 1)) == 0, "FEED_SLOTS must be a power of two");
+
+// Slots and the head each own their cache lines, so readers polling the
+// head do not contend with the slot being written.
+typedef struct {
+    _Atomic uint64_t seq; // Entry number + 1 once written, 0 while it is
+    FeedEntry e;
+} __attribute__((aligned(64))) Slot;
+
+typedef struct {
+    _Atomic uint64_t magic; // Stored last, so a reader that sees it sees the rest
+    uint32_t slots, slot_size;
+    _Atomic uint64_t head __attribute__((aligned(64))); // Entries published
+} __attribute__((aligned(64))) Ring;
+
+#define RING_BYTES (sizeof(Ring) + FEED_SLOTS * sizeof(Slot))
+
+struct Feed {
+    Ring *ring;
+    Slot *slots;
+    uint64_t head;
+    char *name;
+};
+
+struct FeedReader {
+    const Ring *ring;
+    const Slot *slots;
+    uint32_t game;
+    uint64_t next; // First entry not looked at yet
+};
+
+// --- Publishing ---
+Feed *feed_create(const char *name) {
+    Feed *f = calloc(1, sizeof(Feed));
+    char *copy = strdup(name);
+    if (!f || !copy) {
+        free(f);
+        free(copy);
+        errno = ENOMEM;
+        return NULL;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    void *p = MAP_FAILED;
+    if (fd != -1 && ftruncate(fd, RING_BYTES) == 0) {
+        p = mmap(NULL, RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (p == MAP_FAILED) {
+        int e = errno;
+        if (fd != -1) {
+            close(fd);
+            shm_unlink(name);
+        }
+        free(f);
+        free(copy);
+        errno = e;
+        return NULL;
+    }
+    close(fd);
+
+    f->ring = p;
+    f->slots = (Slot *)(f->ring + 1);
+    f->name = copy;
+    f->ring->slots = FEED_SLOTS;
+    f->ring->slot_size = sizeof(Slot);
+    atomic_store_explicit(&f->ring->magic, FEED_MAGIC, memory_order_release);
+    return f;
+}
+
+void feed_publish(Feed *f, uint32_t game, const GameState *g) {
+    uint64_t n = f->head++;
+    Slot *s = &f->slots[n & (FEED_SLOTS - 1)];
+    atomic_store_explicit(&s->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->e.game = game;
+    s->e.width = g->width;
+    s->e.height = g->height;
+    game_snapshot(g, &s->e.s, s->e.tail);
+    for (int y = 0; y < g->height; y++) {
+        uint64_t c = 0;
+        for (int x = 0; x < g->width; x++) c |= (uint64_t)(g->color[y][x] & 15) << 4 * x;
+        s->e.colors[y] = c;
+    }
+
+    atomic_store_explicit(&s->seq, n + 1, memory_order_release);
+    atomic_store_explicit(&f->ring->head, n + 1, memory_order_release);
+}
+
+void feed_destroy(Feed *f) {
+    if (!f) return;
+    shm_unlink(f->name);
+    munmap(f->ring, RING_BYTES);
+    free(f->name);
+    free(f);
+}
+
+// --- Watching ---
+FeedReader *feed_open(const char *name, uint32_t game) {
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1) return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= RING_BYTES) {
+        p = mmap(NULL, RING_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        errno = EINVAL;
+        return NULL;
+    }
+    const Ring *ring = p;
+    if (atomic_load_explicit(&ring->magic, memory_order_acquire) != FEED_MAGIC || ring->slots != FEED_SLOTS ||
+        ring->slot_size != sizeof(Slot)) {
+        munmap(p, RING_BYTES);
+        errno = EINVAL;
+        return NULL;
+    }
+    FeedReader *r = malloc(sizeof(FeedReader));
+    if (!r) {
+        munmap(p, RING_BYTES);
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->ring = ring;
+    r->slots = (const Slot *)(ring + 1);
+    r->game = game;
+    r->next = 0;
+    return r;
+}
+
+// Newest first, so the search usually ends at the first slot looked at.
+int feed_latest(FeedReader *r, FeedEntry *e) {
+    uint64_t head = atomic_load_explicit(&r->ring->head, memory_order_acquire);
+    uint64_t stop = head > FEED_SLOTS ? head - FEED_SLOTS : 0;
+    if (r->next > stop) stop = r->next;
+    r->next = head;
+    for (uint64_t n = head; n-- > stop;) {
+        const Slot *s = &r->slots[n & (FEED_SLOTS - 1)];
+        if (atomic_load_explicit(&s->seq, memory_order_acquire) != n + 1 || s->e.game != r->game) continue;
+        memcpy(e, &s->e, sizeof(*e));
+        atomic_thread_fence(memory_order_acquire);
+        // Torn by an entry past head, which the next call finds
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == n + 1 && e->game == r->game) return 1;
+    }
+    return 0;
+}
+
+void feed_close(FeedReader *r) {
+    if (!r) return;
+    munmap((void *)r->ring, RING_BYTES);
+    free(r);
+}
+
+void feed_restore(GameState *g, const FeedEntry *e) {
+    if (g->width != e->width || g->height != e->height) game_init_sized(g, 0, e->width, e->height);
+    game_restore(g, &e->s, e->tail);
+    for (int y = 0; y < g->height; y++) {
+        for (int x = 0; x < g->width; x++) g->color[y][x] = e->colors[y] >> 4 * x & 15;
+    }
+}
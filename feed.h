@@ -0,0 +1,51 @@
+#ifndef TETRIS_FEED_H
+#define TETRIS_FEED_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// Spectator feed: a game, or a server full of them, publishes every change
+// as an entry in a ring in POSIX shared memory, and any number of local
+// processes map it read-only to follow along. Readers leave no trace in
+// the ring, so the writer never waits on them and costs the same with a
+// thousand as with none. Each slot is a seqlock: a reader that is lapped
+// skips to newer entries, and one that reads a slot as it is rewritten
+// sees the sequence change and drops the copy.
+
+#define FEED_SLOTS 4096 // Entries kept, a power of two
+
+typedef struct {
+    uint32_t game; // Which of the publisher's games, 0 for a lone one
+    uint8_t width, height;
+    GameSnapshot s;
+    uint16_t tail[SNAPSHOT_TAIL_MAX];
+    uint64_t colors[BOARD_MAX_HEIGHT]; // 4 bits per cell, column 0 lowest
+} FeedEntry;
+
+_Static_assert(BOARD_MAX_WIDTH * 4 <= 64, "a row of colors must fit in 64 bits");
+
+// --- Publishing ---
+typedef struct Feed Feed;
+
+// Creates the ring as shared memory object `name` ("/tetris", see
+// shm_open()), replacing any earlier one. NULL with errno set on failure.
+Feed *feed_create(const char *name);
+void feed_publish(Feed *f, uint32_t game, const GameState *g);
+// Removes the object; readers keep what they have mapped.
+void feed_destroy(Feed *f);
+
+// --- Watching ---
+typedef struct FeedReader FeedReader;
+
+// Follows `game` of feed `name`; open one reader per game to follow more.
+// NULL with errno set when there is no such feed.
+FeedReader *feed_open(const char *name, uint32_t game);
+// Copies the newest entry of the game published since the last call into
+// *e. Returns 0 when there is none.
+int feed_latest(FeedReader *r, FeedEntry *e);
+void feed_close(FeedReader *r);
+// The game an entry shows, board size and colors included.
+void feed_restore(GameState *g, const FeedEntry *e);
+
+#endif
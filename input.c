@@ -0,0 +1,126 @@
+#include <limits.h>
+#include <string.h>
+
+#include "input.h"
+
+// --- Key Parsing ---
+static void push_key(KeyQueue *q, int key, int64_t t) {
+    if (q->count == KEY_QUEUE_CAP) {
+        q->dropped++;
+        return;
+    }
+    KeyEvent *ev = &q->events[(q->head + q->count++) % KEY_QUEUE_CAP];
+    ev->key = key;
+    ev->time_us = t;
+}
+
+int key_queue_pop(KeyQueue *q, KeyEvent *ev) {
+    if (q->count == 0) return 0;
+    *ev = q->events[q->head];
+    q->head = (q->head + 1) % KEY_QUEUE_CAP;
+    q->count--;
+    return 1;
+}
+
+// CSI (ESC [) and SS3 (ESC O) sequences end on a byte in 0x40-0x7E.
+// Parameters such as modifiers are ignored.
+static void finish_seq(KeyParser *p, int final, int64_t t, KeyQueue *q) {
+    switch (final) {
+        case 'A': push_key(q, KEY_UP, t); break;
+        case 'B': push_key(q, KEY_DOWN, t); break;
+        case 'C': push_key(q, KEY_RIGHT, t); break;
+        case 'D': push_key(q, KEY_LEFT, t); break;
+    }
+    p->seq_len = 0;
+}
+
+void key_parser_feed(KeyParser *p, const char *bytes, size_t n, int64_t now_us, KeyQueue *q) {
+    if (p->seq_len > 0 && now_us - p->seq_time > ESC_TIMEOUT_US) {
+        p->seq_len = 0;
+        p->dropped++;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = bytes[i];
+        if (c == '\033') {
+            if (p->seq_len > 0) p->dropped++;
+            p->seq[0] = c;
+            p->seq_len = 1;
+            p->seq_time = now_us;
+        } else if (p->seq_len == 0) {
+            push_key(q, c, now_us);
+        } else if (p->seq_len == 1) {
+            if (c == '[' || c == 'O') {
+                p->seq[p->seq_len++] = c;
+            } else {
+                // Escape then a plain key (Alt+key): keep the key
+                p->seq_len = 0;
+                push_key(q, c, now_us);
+            }
+        } else if (c >= 0x40 && c <= 0x7E) {
+            finish_seq(p, c, now_us, q);
+        } else if (p->seq_len < (int)sizeof(p->seq)) {
+            p->seq[p->seq_len++] = c;
+        } else {
+            p->seq_len = 0; // Overlong, not a key we know
+            p->dropped++;
+        }
+    }
+}
+
+// --- Auto-Shift ---
+void autorepeat_init(AutoRepeat *a, int das_ms, int arr_ms) {
+    memset(a, 0, sizeof(*a));
+    a->das_ms = das_ms;
+    a->arr_ms = arr_ms;
+}
+
+int autorepeat_press(AutoRepeat *a, int key, int64_t now_us) {
+    int64_t gap = now_us - a->last_us;
+    int repeat = a->held ? gap <= AR_RELEASE_US : gap >= AR_BURST_US && gap <= AR_REPEAT_GAP_US;
+    if (key == a->key && repeat) {
+        a->last_us = now_us;
+        if (!a->held) {
+            a->held = 1;
+            int64_t start = a->first_us + (int64_t)a->das_ms * 1000;
+            a->next_us = start > now_us ? start : now_us;
+        }
+        return 0;
+    }
+    a->key = key;
+    a->held = 0;
+    a->first_us = a->last_us = now_us;
+    return 1;
+}
+
+void autorepeat_cancel(AutoRepeat *a) {
+    a->key = 0;
+    a->held = 0;
+}
+
+int autorepeat_due(AutoRepeat *a, int64_t now_us) {
+    if (!a->held) return 0;
+
+    int64_t release = a->last_us + AR_RELEASE_US;
+    int64_t until = now_us < release ? now_us : release;
+    int n = 0;
+    if (a->next_us <= until) {
+        if (a->arr_ms == 0) {
+            n = INT_MAX;
+            a->next_us = until + AR_REPEAT_GAP_US; // Re-check for a new piece
+        } else {
+            int64_t arr_us = (int64_t)a->arr_ms * 1000;
+            int64_t k = (until - a->next_us) / arr_us + 1;
+            n = k > INT_MAX ? INT_MAX : (int)k;
+            a->next_us += k * arr_us;
+        }
+    }
+    if (now_us >= release) autorepeat_cancel(a);
+    return n;
+}
+
+int64_t autorepeat_deadline(const AutoRepeat *a) {
+    if (!a->held) return -1;
+    int64_t release = a->last_us + AR_RELEASE_US;
+    return a->next_us < release ? a->next_us : release;
+}
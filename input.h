@@ -0,0 +1,76 @@
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Terminal input: bytes become timestamped key events, and keys held down
+// get their own auto-shift timing instead of the terminal's repeat rate.
+
+// Keys above the byte range. Everything else is the byte itself.
+enum {
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_RIGHT,
+    KEY_LEFT
+};
+
+typedef struct {
+    int key;
+    int64_t time_us; // When the bytes were read
+} KeyEvent;
+
+#define KEY_QUEUE_CAP 256
+
+// FIFO of parsed keys. When full, the newest keys are dropped.
+typedef struct {
+    KeyEvent events[KEY_QUEUE_CAP];
+    int head, count;
+    uint64_t dropped;
+} KeyQueue;
+
+// Escape sequences may arrive split across reads, so the parser keeps the
+// part seen so far. An unfinished sequence older than ESC_TIMEOUT_US is
+// dropped rather than glued to later keystrokes.
+#define ESC_TIMEOUT_US 50000
+
+typedef struct {
+    char seq[16];
+    int seq_len;
+    int64_t seq_time;
+    uint64_t dropped; // Sequences given up on
+} KeyParser;
+
+void key_parser_feed(KeyParser *p, const char *bytes, size_t n, int64_t now_us, KeyQueue *q);
+int key_queue_pop(KeyQueue *q, KeyEvent *ev);
+
+// Delayed auto-shift (DAS) and auto-repeat rate (ARR). Terminals report
+// presses only, repeating them while a key is held. Reports of one key
+// closer together than AR_REPEAT_GAP_US mean it is held; reports under
+// AR_BURST_US apart, faster than any terminal repeats, are separate
+// presses that arrived in one read. From das_ms after the first press a
+// held key shifts every arr_ms, 0 meaning as far as it goes, until its
+// reports stop for AR_RELEASE_US.
+#define AR_REPEAT_GAP_US 90000
+#define AR_BURST_US 5000
+#define AR_RELEASE_US 150000
+
+typedef struct {
+    int das_ms, arr_ms;
+    int key; // Last key reported, 0 for none
+    int held;
+    int64_t first_us, last_us, next_us;
+} AutoRepeat;
+
+void autorepeat_init(AutoRepeat *a, int das_ms, int arr_ms);
+// Feeds a report of a key that auto-shifts. Returns 1 when it is a fresh
+// press to act on, 0 when it is a terminal repeat the auto-shift covers.
+int autorepeat_press(AutoRepeat *a, int key, int64_t now_us);
+// Any other key ends the hold.
+void autorepeat_cancel(AutoRepeat *a);
+// Shifts of the held key due by now_us, INT_MAX for "to the wall".
+int autorepeat_due(AutoRepeat *a, int64_t now_us);
+// Next time autorepeat_due() has anything to do, -1 when nothing is held.
+int64_t autorepeat_deadline(const AutoRepeat *a);
+
+#endif
@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "metrics.h"
+#include "movegen.h"
+#include "net.h"
+
+// Load generator for `tetris --serve`: keeps N bot players connected, each
+// placing every piece with the autoplayer as soon as it sees it, and
+// measures how long the server takes to answer. A player whose match ends
+// joins the next one until time is up. All players share one epoll loop
+// and one search, so the generator costs little next to the server.
+
+typedef struct {
+    int fd; // -1 when it could not reconnect
+    int seat, seats; // seats is 0 until NET_START
+    int width, height;
+    GameSnapshot view[NET_MAX_SEATS];
+    uint16_t tails[NET_MAX_SEATS * SNAPSHOT_TAIL_MAX];
+    int planned;     // Own pieces count the last plan was for
+    int64_t drop_us; // When the last hard drop went out, -1 once answered
+    MovePath path;   // Inputs still to send, paced by --step
+    int sent;
+    int64_t next_step_us;
+    size_t in_len;
+    uint8_t in[4096];
+} Player;
+
+typedef struct {
+    const char *addr;
+    int step_ms;
+    Ai *ai;
+    int epfd;
+    uint64_t matches, wins, pieces, inputs, bytes_in, messages, failures;
+    Histogram rtt_us; // Hard drop sent to the next piece seen
+} Load;
+
+static int64_t mono_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void join(Load *l, Player *p) {
+    memset(p, 0, offsetof(Player, in));
+    p->planned = -1;
+    p->drop_us = -1;
+    p->fd = net_connect(l->addr);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = p };
+    if (p->fd == -1 || epoll_ctl(l->epfd, EPOLL_CTL_ADD, p->fd, &ev) != 0) {
+        if (p->fd != -1) close(p->fd);
+        p->fd = -1;
+        l->failures++;
+    }
+}
+
+static void leave(Player *p) {
+    close(p->fd);
+    p->fd = -1;
+}
+
+// --- Bot ---
+static void send_inputs(Load *l, Player *p, int64_t now) {
+    int n = l->step_ms > 0 ? 1 : p->path.len - p->sent;
+    if (n <= 0) return;
+    ssize_t k = send(p->fd, p->path.actions + p->sent, n, MSG_NOSIGNAL);
+    if (k <= 0) return; // Server not keeping up; the next piece replans
+    l->inputs += k;
+    p->sent += k;
+    if (p->sent == p->path.len) p->drop_us = now;
+    p->next_step_us = now + l->step_ms * 1000;
+}
+
+static void plan(Load *l, Player *p, int64_t now) {
+    GameState g;
+    game_init_sized(&g, 0, p->width, p->height);
+    game_restore(&g, &p->view[p->seat], p->tails + p->seat * SNAPSHOT_TAIL(p->height));
+    p->planned = g.pieces;
+    p->path.len = 0;
+    p->sent = 0;
+
+    Placement best, pl[MOVEGEN_MAX];
+    MovePath paths[MOVEGEN_MAX];
+    if (ai_choose(l->ai, &g, &best)) {
+        int n = gen_placements(&g, pl, paths, MOVEGEN_MAX);
+        for (int i = 0; i < n; i++) {
+            if (pl[i].piece.type == best.piece.type && pl[i].piece.rot == best.piece.rot && pl[i].x == best.x &&
+                pl[i].y == best.y && pl[i].hold == best.hold) {
+                p->path = paths[i];
+                // The hard drop goes as far as the soft drops before it
+                while (p->path.len > 1 && p->path.actions[p->path.len - 2] == ACT_SOFT_DROP) {
+                    p->path.actions[--p->path.len - 1] = ACT_HARD_DROP;
+                }
+                break;
+            }
+        }
+    }
+    if (p->path.len == 0) {
+        p->path.len = 1;
+        p->path.actions[0] = ACT_HARD_DROP;
+    }
+    send_inputs(l, p, now);
+}
+
+// --- Messages ---
+// Returns -1 when the player left its match.
+static int handle(Load *l, Player *p, const uint8_t *msg, size_t len, int64_t now) {
+    l->messages++;
+    switch (msg[0]) {
+        case NET_START:
+            if (len < 5 || msg[2] == 0 || msg[2] > NET_MAX_SEATS || msg[1] >= msg[2] || msg[3] < BOARD_MIN_SIZE ||
+                msg[3] > BOARD_MAX_WIDTH || msg[4] < BOARD_MIN_SIZE || msg[4] > BOARD_MAX_HEIGHT) return -1;
+            p->seat = msg[1];
+            p->seats = msg[2];
+            p->width = msg[3];
+            p->height = msg[4];
+            return 0;
+        case NET_DELTA: {
+            int seat = net_get_delta(msg, len, p->height, p->view, p->tails, p->seats);
+            if (seat < 0) return -1;
+            const GameSnapshot *own = &p->view[p->seat];
+            if (seat != p->seat || own->over || own->pieces == p->planned) return 0;
+            if (p->drop_us >= 0) hist_add(&l->rtt_us, now - p->drop_us);
+            p->drop_us = -1;
+            l->pieces++;
+            plan(l, p, now);
+            return 0;
+        }
+        case NET_END:
+            l->matches++;
+            l->wins += len >= 2 && msg[1] == p->seat;
+            return -1;
+        default:
+            return -1;
+    }
+}
+
+static void receive(Load *l, Player *p) {
+    for (;;) {
+        ssize_t n = read(p->fd, p->in + p->in_len, sizeof(p->in) - p->in_len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && errno == EAGAIN) return;
+        if (n <= 0) break;
+        int64_t now = mono_us(); // The answer may be here before this loop reads again
+        l->bytes_in += n;
+        p->in_len += n;
+
+        size_t at = 0;
+        while (at < p->in_len && at + 1 + p->in[at] <= p->in_len) {
+            size_t len = p->in[at];
+            if (len == 0 || handle(l, p, p->in + at + 1, len, now) != 0) goto rejoin;
+            at += 1 + len;
+        }
+        memmove(p->in, p->in + at, p->in_len - at);
+        p->in_len -= at;
+    }
+rejoin:
+    leave(p);
+    join(l, p);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s ADDR [--players N] [--seconds S] [--step MS] [--depth N] [--beam N]\n"
+                    "Plays N bots (100) against `tetris --serve ADDR` for S seconds (10), sending a\n"
+                    "piece's inputs one per MS ms or, with 0 (default), all at once.\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    Load l = { 0 };
+    int players = 100;
+    double seconds = 10;
+    AiConfig config;
+    ai_config_init(&config);
+    config.depth = 1; // The cheapest search, so the server is what gets measured
+    config.beam = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--players") && val) { players = atoi(val); i++; }
+        else if (!strcmp(arg, "--seconds") && val) { seconds = atof(val); i++; }
+        else if (!strcmp(arg, "--step") && val) { l.step_ms = atoi(val); i++; }
+        else if (!strcmp(arg, "--depth") && val) { config.depth = atoi(val); i++; }
+        else if (!strcmp(arg, "--beam") && val) { config.beam = atoi(val); i++; }
+        else if (arg[0] != '-' && !l.addr) l.addr = arg;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!l.addr || players <= 0 || !(seconds > 0) || l.step_ms < 0 || config.depth < 1 ||
+        config.depth > NEXT_COUNT || config.beam < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    l.ai = ai_create(&config);
+    Player *p = malloc(players * sizeof(Player));
+    l.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!l.ai || !p || l.epfd == -1) {
+        fprintf(stderr, "tetris-load: out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < players; i++) {
+        join(&l, &p[i]);
+        if (p[i].fd == -1) {
+            perror(l.addr);
+            return 1;
+        }
+    }
+
+    int64_t start = mono_us(), end = start + (int64_t)(seconds * 1e6);
+    struct epoll_event events[64];
+    for (int64_t now = start; now < end; now = mono_us()) {
+        int64_t deadline = end;
+        for (int i = 0; i < players && l.step_ms > 0; i++) {
+            if (p[i].fd == -1) continue;
+            if (p[i].sent < p[i].path.len && p[i].next_step_us <= now) send_inputs(&l, &p[i], now);
+            if (p[i].sent < p[i].path.len && p[i].next_step_us < deadline) deadline = p[i].next_step_us;
+        }
+        int n = epoll_wait(l.epfd, events, 64, (int)((deadline - now + 999) / 1000));
+        if (n == -1 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) receive(&l, events[i].data.ptr);
+    }
+    double secs = (mono_us() - start) / 1e6;
+
+    printf("%d players for %.1f s: %llu matches (%llu won), %llu pieces (%.0f/s), %llu inputs\n", players, secs,
+           (unsigned long long)l.matches, (unsigned long long)l.wins, (unsigned long long)l.pieces,
+           l.pieces / secs, (unsigned long long)l.inputs);
+    printf("received %.1f KiB in %llu messages (%.1f bytes each)", l.bytes_in / 1024.0,
+           (unsigned long long)l.messages, l.messages ? (double)l.bytes_in / l.messages : 0.0);
+    if (l.failures) printf(", %llu failed connects", (unsigned long long)l.failures);
+    printf("\n");
+    hist_dump_header(stdout);
+    hist_dump(stdout, "rtt_us", &l.rtt_us);
+
+    for (int i = 0; i < players; i++) {
+        if (p[i].fd != -1) close(p[i].fd);
+    }
+    free(p);
+    ai_destroy(l.ai);
+    return 0;
+}
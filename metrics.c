@@ -0,0 +1,75 @@
+#include "metrics.h"
+
+// --- Histograms ---
+static int bucket_of(uint64_t v) {
+    if (v < 4) return (int)v;
+    int e = 63 - __builtin_clzll(v); // >= 2
+    int i = 4 * (e - 1) + (int)(v >> (e - 2) & 3);
+    return i < HIST_BUCKETS ? i : HIST_BUCKETS - 1;
+}
+
+static uint64_t bucket_low(int i) {
+    if (i < 4) return (uint64_t)i;
+    int e = i / 4 + 1;
+    return (uint64_t)(4 + i % 4) << (e - 2);
+}
+
+void hist_add(Histogram *h, uint64_t v) {
+    h->count++;
+    h->sum += v;
+    if (v > h->max) h->max = v;
+    h->buckets[bucket_of(v)]++;
+}
+
+uint64_t hist_percentile(const Histogram *h, double p) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100 * (h->count - 1)), seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) return bucket_low(i);
+    }
+    return h->max;
+}
+
+// --- Reports ---
+void hist_dump_header(FILE *f) {
+    fprintf(f, "%-10s %10s %10s %8s %8s %8s %8s %10s\n", "", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+}
+
+void hist_dump(FILE *f, const char *name, const Histogram *h) {
+    fprintf(f, "%-10s %10llu %10.1f %8llu %8llu %8llu %8llu %10llu\n", name, (unsigned long long)h->count,
+            h->count ? (double)h->sum / h->count : 0.0, (unsigned long long)hist_percentile(h, 50),
+            (unsigned long long)hist_percentile(h, 90), (unsigned long long)hist_percentile(h, 99),
+            (unsigned long long)hist_percentile(h, 99.9), (unsigned long long)h->max);
+}
+
+void metrics_dump(const Metrics *m, FILE *f) {
+    static const char *names[PHASES] = { "sim_us", "compose_us", "write_us" };
+    hist_dump_header(f);
+    for (int i = 0; i < PHASES; i++) hist_dump(f, names[i], &m->phase[i]);
+    hist_dump(f, "key_us", &m->latency);
+    hist_dump(f, "bytes", &m->bytes);
+    fprintf(f, "keys %llu  dropped %llu  escapes dropped %llu  short writes %llu\n", (unsigned long long)m->keys,
+            (unsigned long long)m->keys_dropped, (unsigned long long)m->esc_dropped,
+            (unsigned long long)m->short_writes);
+}
+
+int metrics_overlay(const Metrics *m, char *lines, int cols, int max) {
+    static const char *names[PHASES] = { "sim", "draw", "write" };
+    int n = 0;
+#define LINE(...) \
+    if (n < max) snprintf(lines + (size_t)(cols + 1) * n++, cols + 1, __VA_ARGS__)
+    LINE("us    p50   p99   max");
+    for (int i = 0; i < PHASES; i++) {
+        const Histogram *h = &m->phase[i];
+        LINE("%-5s %-5llu %-5llu %llu", names[i], (unsigned long long)hist_percentile(h, 50),
+             (unsigned long long)hist_percentile(h, 99), (unsigned long long)h->max);
+    }
+    LINE("key   %-5llu %-5llu %llu", (unsigned long long)hist_percentile(&m->latency, 50),
+         (unsigned long long)hist_percentile(&m->latency, 99), (unsigned long long)m->latency.max);
+    LINE("bytes %-5llu %-5llu %llu", (unsigned long long)hist_percentile(&m->bytes, 50),
+         (unsigned long long)hist_percentile(&m->bytes, 99), (unsigned long long)m->bytes.max);
+    LINE("drop %llu/%llu keys", (unsigned long long)(m->keys_dropped + m->esc_dropped), (unsigned long long)m->keys);
+#undef LINE
+    return n;
+}
@@ -0,0 +1,54 @@
+#ifndef TETRIS_METRICS_H
+#define TETRIS_METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Runtime metrics of the interactive front end: where each frame's time
+// went, how long a key takes to reach the screen and how many bytes a
+// frame costs. Recording is a bucket increment, cheap enough to stay on.
+
+// Log-linear histogram: values below 4 exactly, then four buckets per
+// power of two, so any percentile is within 25%. Values past the last
+// bucket land in it.
+#define HIST_BUCKETS 96
+
+typedef struct {
+    uint64_t count, sum, max;
+    uint32_t buckets[HIST_BUCKETS];
+} Histogram;
+
+void hist_add(Histogram *h, uint64_t v);
+// Lower bound of the bucket holding the p-th percentile (0-100), 0 when
+// empty.
+uint64_t hist_percentile(const Histogram *h, double p);
+// One line of count, mean, percentiles and max under the header's columns.
+void hist_dump_header(FILE *f);
+void hist_dump(FILE *f, const char *name, const Histogram *h);
+
+// Per frame, in microseconds: game work since the previous frame (gravity,
+// keys, the bot), composing the frame and writing it to the terminal.
+typedef enum {
+    PHASE_SIM,
+    PHASE_COMPOSE,
+    PHASE_WRITE,
+    PHASES
+} Phase;
+
+typedef struct {
+    Histogram phase[PHASES];
+    Histogram latency; // Key read to the frame showing it written, us
+    Histogram bytes;   // Per frame
+    uint64_t keys;
+    uint64_t keys_dropped; // Key queue full
+    uint64_t esc_dropped;  // Unfinished escape sequences given up on
+    uint64_t short_writes; // Writes that left part of a frame for later
+} Metrics;
+
+// Readable summary, one histogram per line.
+void metrics_dump(const Metrics *m, FILE *f);
+// Fills up to `max` lines of `cols` chars plus the terminator, stored
+// cols + 1 apart, for the side panel. Returns how many.
+int metrics_overlay(const Metrics *m, char *lines, int cols, int max);
+
+#endif
@@ -0,0 +1,300 @@
+#include <string.h>
+
+#include "movegen.h"
+
+// Search space: every (y, x, rot) of a piece box. x reaches X_OFF columns
+// left of the board, y Y_OFF rows above it for pieces kicked upwards.
+// Rows come outermost, so a board of any height uses the front of the
+// arrays only.
+#define X_OFF 3
+#define Y_OFF 8
+#define GEN_COLS (BOARD_MAX_WIDTH + X_OFF)
+#define GEN_ROWS (BOARD_MAX_HEIGHT + Y_OFF)
+#define GEN_STATES (4 * GEN_ROWS * GEN_COLS)
+#define ROOT 0xFFFF // Parent of the states a search starts from
+
+_Static_assert(GEN_STATES < ROOT, "state indices must fit in 16 bits");
+
+typedef struct {
+    const GameState *g;
+    int width, height;
+    Tetromino start;
+    int start_x, start_y;
+    int open;   // Searching only below the open space over the stack
+    int low[4]; // Per rotation, lowest y still in the open space
+    uint8_t shape_id[4]; // Lowest rotation with the same cells, for dedup
+    // Per rotation and y: bit c set when the piece fits with its box's
+    // leftmost filled column at c
+    uint16_t fit[4][GEN_ROWS];
+    uint16_t placed[4][GEN_ROWS]; // Per shape id and top row: left columns done
+    uint8_t seen[GEN_STATES];
+    uint16_t parent[GEN_STATES];
+    uint8_t move[GEN_STATES];
+    uint16_t queue[GEN_STATES];
+    int tail;
+} Search;
+
+static inline int state_index(int rot, int x, int y) {
+    return ((y + Y_OFF) * GEN_COLS + x + X_OFF) * 4 + rot;
+}
+
+static inline int fits(const Search *s, int rot, int x, int y) {
+    int col = x + PIECES[s->start.type][rot].left;
+    if (y < -Y_OFF || y >= s->height || col < 0) return 0;
+    return s->fit[rot][y + Y_OFF] >> col & 1;
+}
+
+// Every collision test of the search at once: a shape row with cells at
+// bits b collides at column c when the board row has any bit c + b, so
+// OR-ing the board row shifted right by each b gives the blocked columns.
+// Above the stack only the walls block. The O piece never turns.
+static inline __attribute__((always_inline)) void fits_of(Search *s, int W, int H) {
+    const GameState *g = s->g;
+    int stack_top = H; // First row with a filled cell
+    for (int x = 0; x < W; x++) {
+        if (H - g->col_height[x] < stack_top) stack_top = H - g->col_height[x];
+    }
+    int turns = s->start.type == PIECE_O ? 1 : 4;
+    for (int k = 0; k < turns; k++) {
+        int rot = (s->start.rot + k) & 3;
+        const PieceShape *m = &PIECES[s->start.type][rot];
+        uint16_t cols = (uint16_t)((1u << (W - m->width + 1)) - 1);
+        int y = -Y_OFF;
+        for (; y + m->top + m->height <= stack_top; y++) s->fit[rot][y + Y_OFF] = cols;
+        for (; y < H; y++) {
+            int row = y + m->top;
+            uint16_t blocked = 0;
+            for (int r = 0; r < m->height; r++) {
+                if (row + r < 0) continue;
+                if (row + r >= H) {
+                    blocked = cols; // Below the floor
+                    break;
+                }
+                for (unsigned bits = m->rows[r]; bits; bits &= bits - 1) {
+                    blocked |= g->rows[row + r] >> __builtin_ctz(bits);
+                }
+            }
+            s->fit[rot][y + Y_OFF] = cols & ~blocked;
+        }
+    }
+}
+
+static void build_fits(Search *s) {
+    BOARD_SPECIALIZE(s->width, s->height, fits_of, s);
+}
+
+// piece_rotate() against the fit masks.
+static int turn(const Search *s, int rot, int *x, int *y) {
+    if (s->start.type == PIECE_O) return -1;
+    int next = (rot + 1) & 3;
+    const Point *kick = KICKS[s->start.type == PIECE_I][rot];
+    for (int k = 0; k < KICK_TESTS; k++) {
+        if (fits(s, next, *x + kick[k].x, *y + kick[k].y)) {
+            *x += kick[k].x;
+            *y += kick[k].y;
+            return next;
+        }
+    }
+    return -1;
+}
+
+static inline int in_open(const Search *s, int rot, int y) {
+    return s->open && y >= s->start_y && y <= s->low[rot];
+}
+
+static void visit(Search *s, int from, uint8_t move, int rot, int x, int y) {
+    if (x < -X_OFF || x >= s->width || y < -Y_OFF || y >= s->height) return;
+    if (in_open(s, rot, y)) return;
+    int i = state_index(rot, x, y);
+    if (s->seen[i]) return;
+    s->seen[i] = 1;
+    s->parent[i] = (uint16_t)from;
+    s->move[i] = move;
+    s->queue[s->tail++] = (uint16_t)i;
+}
+
+// Marks a state in the open space as reached from the start directly.
+static int root(Search *s, int rot, int x, int y) {
+    int i = state_index(rot, x, y);
+    s->seen[i] = 1;
+    s->parent[i] = ROOT;
+    return i;
+}
+
+// Where the search starts. High above the stack only the walls matter:
+// every rotation turns with an unkicked or sideways kick and every column
+// is reachable, so every state in that open space below the start is
+// reachable too. The search skips it and starts where it ends: from the
+// lowest open row of each rotation and column, and from the rotations
+// that leave it. A kick moves a piece down two rows at most, so those
+// start at most two rows above the target rotation's lowest open row.
+static void seed(Search *s) {
+    const GameState *g = s->g;
+    int stack_h = 0;
+    for (int x = 0; x < s->width; x++) {
+        if (g->col_height[x] > stack_h) stack_h = g->col_height[x];
+    }
+    int open_rows = s->height - stack_h; // Rows above the highest cell
+
+    s->open = s->start_y + 3 < open_rows;
+    if (!s->open) {
+        visit(s, ROOT, 0, s->start.rot, s->start_x, s->start_y);
+        return;
+    }
+    int turns = s->start.type == PIECE_O ? 1 : 4;
+    for (int rot = 0; rot < 4; rot++) {
+        const PieceShape *m = &PIECES[s->start.type][rot];
+        s->low[rot] = open_rows - m->top - m->height;
+    }
+    for (int k = 0; k < turns; k++) {
+        int rot = (s->start.rot + k) & 3;
+        const PieceShape *m = &PIECES[s->start.type][rot];
+        int next = (rot + 1) & 3;
+        int from = s->low[next] - 1 > s->start_y ? s->low[next] - 1 : s->start_y;
+        for (int x = -m->left; x + m->left + m->width <= s->width; x++) {
+            int i = root(s, rot, x, s->low[rot]);
+            s->queue[s->tail++] = (uint16_t)i;
+            if (turns == 1) continue;
+            for (int y = from; y < s->low[rot]; y++) {
+                int rx = x, ry = y;
+                int to = turn(s, rot, &rx, &ry);
+                if (to >= 0 && !in_open(s, to, ry)) {
+                    visit(s, root(s, rot, x, y), ACT_ROTATE, to, rx, ry);
+                }
+            }
+        }
+    }
+}
+
+// Inputs from the start state to a root state: turns, shifts, then drops.
+static int root_path(const Search *s, int rot, int x, int y, uint8_t *out, int max) {
+    Tetromino p = s->start;
+    int px = s->start_x, py = s->start_y, n = 0;
+    while (p.rot != rot) {
+        if (n == max || !piece_rotate(s->g, &p, &px, &py)) return -1;
+        out[n++] = ACT_ROTATE;
+    }
+    for (; px != x; px += x < px ? -1 : 1) {
+        if (n == max) return -1;
+        out[n++] = x < px ? ACT_LEFT : ACT_RIGHT;
+    }
+    for (; py < y; py++) {
+        if (n == max) return -1;
+        out[n++] = ACT_SOFT_DROP;
+    }
+    return py == y ? n : -1;
+}
+
+static void build_path(const Search *s, int i, int hold, MovePath *path) {
+    uint8_t tail[MOVE_PATH_MAX];
+    int len = 0;
+    for (; s->parent[i] != ROOT; i = s->parent[i]) {
+        if (len == MOVE_PATH_MAX) goto too_long;
+        tail[len++] = s->move[i];
+    }
+
+    int rot = i & 3;
+    int x = i / 4 % GEN_COLS - X_OFF;
+    int y = i / 4 / GEN_COLS - Y_OFF;
+    int n = 0;
+    if (hold) path->actions[n++] = ACT_HOLD;
+    int head = root_path(s, rot, x, y, path->actions + n, MOVE_PATH_MAX - n);
+    if (head < 0 || n + head + len + 1 > MOVE_PATH_MAX) goto too_long;
+    n += head;
+    while (len > 0) path->actions[n++] = tail[--len];
+    path->actions[n++] = ACT_HARD_DROP;
+    path->len = (uint8_t)n;
+    return;
+
+too_long:
+    path->len = 0;
+}
+
+// Breadth-first over shifts, soft drops and turns from the seeds. Every
+// state resting on something is a placement.
+static int search(Search *s, int hold, Placement *out, MovePath *paths, int n, int max) {
+    build_fits(s);
+    if (!fits(s, s->start.rot, s->start_x, s->start_y)) return n;
+
+    memset(s->seen, 0, state_index(0, -X_OFF, s->height));
+    memset(s->placed, 0, sizeof(s->placed));
+    for (int r = 0; r < 4; r++) {
+        const PieceShape *m = &PIECES[s->start.type][r];
+        s->shape_id[r] = (uint8_t)r;
+        for (int q = 0; q < r; q++) {
+            const PieceShape *o = &PIECES[s->start.type][q];
+            if (!memcmp(m->rows, o->rows, sizeof(m->rows)) && m->height == o->height) {
+                s->shape_id[r] = (uint8_t)q;
+                break;
+            }
+        }
+    }
+
+    s->tail = 0;
+    seed(s);
+    for (int head = 0; head < s->tail; head++) {
+        int i = s->queue[head];
+        int rot = i & 3;
+        int x = i / 4 % GEN_COLS - X_OFF;
+        int y = i / 4 / GEN_COLS - Y_OFF;
+        const PieceShape *m = &PIECES[s->start.type][rot];
+
+        if (fits(s, rot, x - 1, y)) visit(s, i, ACT_LEFT, rot, x - 1, y);
+        if (fits(s, rot, x + 1, y)) visit(s, i, ACT_RIGHT, rot, x + 1, y);
+        int rx = x, ry = y;
+        int to = turn(s, rot, &rx, &ry);
+        if (to >= 0) visit(s, i, ACT_ROTATE, to, rx, ry);
+        if (fits(s, rot, x, y + 1)) {
+            visit(s, i, ACT_SOFT_DROP, rot, x, y + 1);
+            continue;
+        }
+
+        // Resting: a placement, unless another state already covers the
+        // same cells
+        uint16_t *placed = &s->placed[s->shape_id[rot]][y + m->top + Y_OFF];
+        uint16_t bit = (uint16_t)(1u << (x + m->left));
+        if ((*placed & bit) || n == max) continue;
+        *placed |= bit;
+        out[n].piece.type = s->start.type;
+        out[n].piece.rot = (uint8_t)rot;
+        out[n].x = (int8_t)x;
+        out[n].y = (int8_t)y;
+        out[n].hold = (uint8_t)hold;
+        if (paths) build_path(s, i, hold, &paths[n]);
+        n++;
+    }
+    return n;
+}
+
+int gen_placements(const GameState *g, Placement *out, MovePath *paths, int max) {
+    if (g->state != GAME_PLAY) return 0;
+
+    Search s;
+    s.g = g;
+    s.width = g->width;
+    s.height = g->height;
+    s.start = g->current_piece;
+    s.start_x = g->piece_x;
+    s.start_y = g->piece_y;
+    int n = search(&s, 0, out, paths, 0, max);
+
+    if (!g->hold_locked) {
+        int type = g->hold_idx != -1 ? g->hold_idx : g->next_queue[0].type;
+        s.start.type = (uint8_t)type;
+        s.start.rot = 0;
+        s.start_x = SPAWN_X(g->width);
+        s.start_y = 0;
+        n = search(&s, 1, out, paths, n, max);
+    }
+    return n;
+}
+
+int game_place(GameState *g, const Placement *p) {
+    if (g->state != GAME_PLAY) return 0;
+    if (p->hold && !game_apply(g, ACT_HOLD)) return 0;
+    if (g->state != GAME_PLAY || check_collision(g, &p->piece, p->x, p->y)) return 0;
+    g->current_piece = p->piece;
+    g->piece_x = p->x;
+    g->piece_y = p->y;
+    return game_apply(g, ACT_HARD_DROP);
+}
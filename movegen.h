@@ -0,0 +1,39 @@
+#ifndef TETRIS_MOVEGEN_H
+#define TETRIS_MOVEGEN_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// Placement generator for bots: every distinct spot the current piece can
+// lock in through legal inputs (shifts, soft drops and kicked rotations,
+// so tucks and spins included), not only straight hard drops. Placements
+// with the same final cells count once.
+
+#define MOVE_PATH_MAX 64
+#define MOVEGEN_MAX 256 // Well above what real boards give; gen_placements() stops at max
+
+typedef struct {
+    Tetromino piece; // Type and rotation when it locks
+    int8_t x, y;     // piece_x / piece_y when it locks
+    uint8_t hold;    // Swap with the hold slot first
+} Placement;
+
+// Inputs that reach a placement from the current state.
+typedef struct {
+    uint8_t len;
+    uint8_t actions[MOVE_PATH_MAX]; // Action values, ending in ACT_HARD_DROP
+} MovePath;
+
+// Fills `out` with the placements of the current piece, then those of the
+// hold piece (the next piece when hold is empty) unless hold is used up.
+// `paths`, when not NULL, gets the shortest input path to each one, or
+// len 0 if it does not fit in MOVE_PATH_MAX. Returns the count, at most
+// `max`.
+int gen_placements(const GameState *g, Placement *out, MovePath *paths, int max);
+
+// Locks a placement as if its path had been played. Returns 0 when the
+// game is over or the placement does not fit.
+int game_place(GameState *g, const Placement *p);
+
+#endif
@@ -0,0 +1,214 @@
+#define _DEFAULT_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net.h"
+
+// --- Sockets ---
+typedef struct {
+    union {
+        struct sockaddr sa;
+        struct sockaddr_un un;
+        struct sockaddr_in in;
+    } u;
+    socklen_t len;
+} Address;
+
+static int parse_addr(const char *addr, Address *a) {
+    memset(a, 0, sizeof(*a));
+    if (strncmp(addr, "unix:", 5) == 0) {
+        const char *path = addr + 5;
+        if (!*path || strlen(path) >= sizeof(a->u.un.sun_path)) return -1;
+        a->u.un.sun_family = AF_UNIX;
+        strcpy(a->u.un.sun_path, path);
+        a->len = sizeof(a->u.un);
+        return 0;
+    }
+
+    char host[64] = "127.0.0.1";
+    const char *port = strrchr(addr, ':');
+    if (port) {
+        size_t n = (size_t)(port - addr);
+        if (n == 0 || n >= sizeof(host)) return -1;
+        memcpy(host, addr, n);
+        host[n] = '\0';
+        port++;
+    } else {
+        port = addr;
+    }
+    char *end;
+    long p = strtol(port, &end, 10);
+    if (*port == '\0' || *end != '\0' || p < 1 || p > 65535) return -1;
+    a->u.in.sin_family = AF_INET;
+    a->u.in.sin_port = htons((uint16_t)p);
+    if (inet_pton(AF_INET, host, &a->u.in.sin_addr) != 1) return -1;
+    a->len = sizeof(a->u.in);
+    return 0;
+}
+
+int net_listen(const char *addr) {
+    Address a;
+    if (parse_addr(addr, &a) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = socket(a.u.sa.sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    if (a.u.sa.sa_family == AF_UNIX) {
+        // A socket left behind by an earlier server, never any other file
+        struct stat st;
+        if (stat(a.u.un.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(a.u.un.sun_path);
+    } else {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(fd, &a.u.sa, a.len) != 0 || listen(fd, SOMAXCONN) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+int net_connect(const char *addr) {
+    Address a;
+    if (parse_addr(addr, &a) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = socket(a.u.sa.sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, &a.u.sa, a.len) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    if (a.u.sa.sa_family == AF_INET) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// --- Messages ---
+#define PIECE_BYTES 6
+#define STATS_BYTES 12
+
+void net_view(const GameState *g, GameSnapshot *view, uint16_t *tail) {
+    game_snapshot(g, view, tail);
+    view->bag_seed = 0;
+    view->bag_head = 0;
+}
+
+static void put_piece(uint8_t *o, const GameSnapshot *s) {
+    o[0] = (uint8_t)(s->type | s->rot << 3 | s->hold_locked << 5 | s->over << 6);
+    o[1] = (uint8_t)s->x;
+    o[2] = (uint8_t)s->y;
+    o[3] = (uint8_t)s->hold;
+    o[4] = (uint8_t)s->next;
+    o[5] = (uint8_t)(s->next >> 8);
+}
+
+static void get_piece(const uint8_t *p, GameSnapshot *s) {
+    s->type = p[0] & 7;
+    s->rot = p[0] >> 3 & 3;
+    s->hold_locked = p[0] >> 5 & 1;
+    s->over = p[0] >> 6 & 1;
+    s->x = p[1];
+    s->y = p[2];
+    s->hold = p[3];
+    s->next = p[4] | (uint32_t)p[5] << 8;
+}
+
+size_t net_put_delta(uint8_t *out, int seat, int height, GameSnapshot *sent, uint16_t *sent_tail,
+                     const GameSnapshot *now, const uint16_t *now_tail) {
+    uint8_t *o = out + 4;
+    int parts = 0;
+
+    uint8_t was[PIECE_BYTES];
+    put_piece(was, sent);
+    put_piece(o, now);
+    if (memcmp(was, o, PIECE_BYTES) != 0) {
+        parts |= NET_PIECE;
+        o += PIECE_BYTES;
+    }
+
+    if (now->score != sent->score || now->lines != sent->lines || now->pieces != sent->pieces) {
+        parts |= NET_STATS;
+        int32_t stats[3] = { now->score, now->lines, now->pieces };
+        memcpy(o, stats, STATS_BYTES);
+        o += STATS_BYTES;
+    }
+
+    int mask_bytes = (height + 7) / 8;
+    uint64_t mask = 0;
+    for (int y = 0; y < height; y++) {
+        mask |= (uint64_t)(SNAPSHOT_ROW(now, now_tail, y) != SNAPSHOT_ROW(sent, sent_tail, y)) << y;
+    }
+    if (mask) {
+        parts |= NET_ROWS;
+        for (int i = 0; i < mask_bytes; i++) *o++ = (uint8_t)(mask >> 8 * i);
+        for (uint64_t m = mask; m; m &= m - 1) {
+            int y = __builtin_ctzll(m);
+            memcpy(o, &SNAPSHOT_ROW(now, now_tail, y), 2);
+            o += 2;
+        }
+    }
+
+    if (!parts) return 0;
+    *sent = *now;
+    memcpy(sent_tail, now_tail, SNAPSHOT_TAIL(height) * sizeof(*sent_tail));
+    out[0] = (uint8_t)(o - out - 1);
+    out[1] = NET_DELTA;
+    out[2] = (uint8_t)seat;
+    out[3] = (uint8_t)parts;
+    return (size_t)(o - out);
+}
+
+int net_get_delta(const uint8_t *msg, size_t len, int height, GameSnapshot *views, uint16_t *tails, int seats) {
+    if (len < 3 || msg[0] != NET_DELTA || msg[1] >= seats) return -1;
+    int seat = msg[1], parts = msg[2];
+    GameSnapshot *s = &views[seat];
+    uint16_t *tail = tails + seat * SNAPSHOT_TAIL(height);
+    const uint8_t *p = msg + 3, *end = msg + len;
+
+    if (parts & NET_PIECE) {
+        if (end - p < PIECE_BYTES) return -1;
+        get_piece(p, s);
+        p += PIECE_BYTES;
+    }
+    if (parts & NET_STATS) {
+        if (end - p < STATS_BYTES) return -1;
+        int32_t stats[3];
+        memcpy(stats, p, STATS_BYTES);
+        s->score = stats[0];
+        s->lines = stats[1];
+        s->pieces = stats[2];
+        p += STATS_BYTES;
+    }
+    if (parts & NET_ROWS) {
+        int mask_bytes = (height + 7) / 8;
+        if (end - p < mask_bytes) return -1;
+        uint64_t mask = 0;
+        for (int i = 0; i < mask_bytes; i++) mask |= (uint64_t)*p++ << 8 * i;
+        if (mask >> height || end - p < 2 * __builtin_popcountll(mask)) return -1;
+        for (; mask; mask &= mask - 1) {
+            int y = __builtin_ctzll(mask);
+            memcpy(&SNAPSHOT_ROW(s, tail, y), p, 2);
+            p += 2;
+        }
+    }
+    return p == end ? seat : -1;
+}
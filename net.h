@@ -0,0 +1,58 @@
+#ifndef TETRIS_NET_H
+#define TETRIS_NET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// Versus protocol of `tetris --serve`, meant for one box: Unix domain or
+// loopback TCP sockets, native byte order.
+//
+// A client sends one byte per input, an Action. The server sends messages
+//
+//   length (1 byte, of what follows) | type (1 byte) | payload
+//
+//   NET_START  seat, seats, board width, height: the match began
+//   NET_DELTA  seat | parts (1 byte) | the parts that changed, in order:
+//              NET_PIECE  piece, position, hold, game over and preview
+//              NET_STATS  score, lines, pieces (4 bytes each)
+//              NET_ROWS   mask of changed rows ((height + 7) / 8 bytes),
+//                         then each of those rows (2 bytes)
+//   NET_END    winning seat, NET_NO_SEAT when nobody won
+//
+// Every client gets the deltas of every seat in its match. A delta takes
+// the client's copy of a seat's game from the last one it got to now, so
+// any number of changes go out as one. The bag is never sent, only the
+// preview.
+
+#define NET_MAX_SEATS 8
+#define NET_MSG_MAX 128 // Longest message, length byte included
+#define NET_NO_SEAT 0xFF
+
+enum { NET_START = 1, NET_DELTA, NET_END };
+enum { NET_PIECE = 1, NET_STATS = 2, NET_ROWS = 4 };
+
+// --- Sockets ---
+// "unix:PATH", or "[HOST:]PORT" for TCP on HOST, 127.0.0.1 by default.
+// Both return a non-blocking socket, or -1 with errno set (EINVAL for an
+// address they cannot parse).
+int net_listen(const char *addr);
+int net_connect(const char *addr);
+
+// --- Messages ---
+// Views are snapshots of games on the match's board, `height` rows high,
+// each with its tail (see game_snapshot()).
+// What a client sees of g: its snapshot without the bag.
+void net_view(const GameState *g, GameSnapshot *view, uint16_t *tail);
+// Writes a NET_DELTA that takes *sent to *now into out, which must have
+// NET_MSG_MAX bytes, and sets *sent = *now. Returns its size, 0 when
+// nothing changed.
+size_t net_put_delta(uint8_t *out, int seat, int height, GameSnapshot *sent, uint16_t *sent_tail,
+                     const GameSnapshot *now, const uint16_t *now_tail);
+// Applies a NET_DELTA, given from its type byte on, to views[seat]. The
+// tails are SNAPSHOT_TAIL(height) rows per seat, one after the other.
+// Returns the seat, or -1 for a malformed message.
+int net_get_delta(const uint8_t *msg, size_t len, int height, GameSnapshot *views, uint16_t *tails, int seats);
+
+#endif
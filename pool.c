@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+typedef struct {
+    TaskFn fn;
+    void *arg;
+    TaskGroup *grp;
+} Task;
+
+// Growable ring of tasks. The owner works at the bottom, thieves take the
+// top, so stolen work is the oldest and usually the largest.
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    long top, bottom, cap;
+} Deque;
+
+struct Pool {
+    int n;
+    pthread_t *threads;
+    Deque *deques;
+
+    atomic_long queued; // Tasks sitting in any deque
+    atomic_int sleepers;
+    atomic_int stop;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+typedef struct {
+    Pool *pool;
+    int id;
+} WorkerArg;
+
+static _Thread_local int worker_id = -1;
+static _Thread_local unsigned int steal_seed = 1;
+
+// --- Deque ---
+static void deque_init(Deque *d) {
+    pthread_mutex_init(&d->lock, NULL);
+    d->cap = 64;
+    d->tasks = malloc(d->cap * sizeof(Task));
+    d->top = d->bottom = 0;
+}
+
+static void deque_free(Deque *d) {
+    pthread_mutex_destroy(&d->lock);
+    free(d->tasks);
+}
+
+static void deque_push(Deque *d, Task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom - d->top == d->cap) {
+        Task *grown = malloc(2 * d->cap * sizeof(Task));
+        for (long i = d->top; i < d->bottom; i++) grown[i % (2 * d->cap)] = d->tasks[i % d->cap];
+        free(d->tasks);
+        d->tasks = grown;
+        d->cap *= 2;
+    }
+    d->tasks[d->bottom % d->cap] = t;
+    d->bottom++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static int deque_pop(Deque *d, Task *out) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) {
+        d->bottom--;
+        *out = d->tasks[d->bottom % d->cap];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static int deque_steal(Deque *d, Task *out) {
+    int ok = 0;
+    if (pthread_mutex_trylock(&d->lock) != 0) return 0;
+    if (d->bottom > d->top) {
+        *out = d->tasks[d->top % d->cap];
+        d->top++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+// --- Scheduling ---
+static int find_task(Pool *p, int id, Task *out) {
+    if (atomic_load(&p->queued) == 0) return 0;
+    if (deque_pop(&p->deques[id], out)) goto found;
+
+    int start = rand_r(&steal_seed) % p->n;
+    for (int i = 0; i < p->n; i++) {
+        int victim = (start + i) % p->n;
+        if (victim != id && deque_steal(&p->deques[victim], out)) goto found;
+    }
+    return 0;
+
+found:
+    atomic_fetch_sub(&p->queued, 1);
+    return 1;
+}
+
+static void run_task(Task *t) {
+    t->fn(t->arg);
+    atomic_fetch_sub(&t->grp->pending, 1);
+}
+
+static void *worker_main(void *arg) {
+    WorkerArg *wa = arg;
+    Pool *p = wa->pool;
+    worker_id = wa->id;
+    steal_seed = wa->id * 2654435761u + 1;
+    free(wa);
+
+    Task t;
+    while (!atomic_load(&p->stop)) {
+        if (find_task(p, worker_id, &t)) {
+            run_task(&t);
+            continue;
+        }
+        pthread_mutex_lock(&p->idle_lock);
+        atomic_fetch_add(&p->sleepers, 1);
+        while (atomic_load(&p->queued) == 0 && !atomic_load(&p->stop))
+            pthread_cond_wait(&p->idle_cond, &p->idle_lock);
+        atomic_fetch_sub(&p->sleepers, 1);
+        pthread_mutex_unlock(&p->idle_lock);
+    }
+    return NULL;
+}
+
+// --- Public API ---
+Pool *pool_create(int threads) {
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+
+    Pool *p = calloc(1, sizeof(Pool));
+    p->n = threads;
+    p->deques = calloc(threads, sizeof(Deque));
+    for (int i = 0; i < threads; i++) deque_init(&p->deques[i]);
+    pthread_mutex_init(&p->idle_lock, NULL);
+    pthread_cond_init(&p->idle_cond, NULL);
+
+    worker_id = 0;
+    p->threads = calloc(threads, sizeof(pthread_t));
+    for (int i = 1; i < threads; i++) {
+        WorkerArg *wa = malloc(sizeof(WorkerArg));
+        wa->pool = p;
+        wa->id = i;
+        pthread_create(&p->threads[i], NULL, worker_main, wa);
+    }
+    return p;
+}
+
+void pool_destroy(Pool *p) {
+    pthread_mutex_lock(&p->idle_lock);
+    atomic_store(&p->stop, 1);
+    pthread_cond_broadcast(&p->idle_cond);
+    pthread_mutex_unlock(&p->idle_lock);
+    for (int i = 1; i < p->n; i++) pthread_join(p->threads[i], NULL);
+
+    for (int i = 0; i < p->n; i++) deque_free(&p->deques[i]);
+    pthread_mutex_destroy(&p->idle_lock);
+    pthread_cond_destroy(&p->idle_cond);
+    free(p->deques);
+    free(p->threads);
+    free(p);
+    worker_id = -1;
+}
+
+int pool_size(const Pool *p) {
+    return p->n;
+}
+
+int pool_worker_id(void) {
+    return worker_id;
+}
+
+void pool_group_init(TaskGroup *grp) {
+    atomic_init(&grp->pending, 0);
+}
+
+void pool_submit(Pool *p, TaskGroup *grp, TaskFn fn, void *arg) {
+    Task t = { fn, arg, grp };
+    atomic_fetch_add(&grp->pending, 1);
+    deque_push(&p->deques[worker_id < 0 ? 0 : worker_id], t);
+    atomic_fetch_add(&p->queued, 1);
+
+    if (atomic_load(&p->sleepers) > 0) {
+        pthread_mutex_lock(&p->idle_lock);
+        pthread_cond_signal(&p->idle_cond);
+        pthread_mutex_unlock(&p->idle_lock);
+    }
+}
+
+void pool_wait(Pool *p, TaskGroup *grp) {
+    int id = worker_id < 0 ? 0 : worker_id;
+    Task t;
+    while (atomic_load(&grp->pending) > 0) {
+        if (find_task(p, id, &t)) run_task(&t);
+        else sched_yield();
+    }
+}
+
+// --- Parallel For ---
+typedef struct {
+    Pool *pool;
+    TaskGroup *grp;
+    RangeFn fn;
+    void *ctx;
+    long begin, end, grain;
+} RangeTask;
+
+static void range_task(void *arg) {
+    RangeTask *r = arg;
+    // Hand the upper halves to the deque, where idle workers can take them,
+    // and keep splitting the lower half locally.
+    while (r->end - r->begin > r->grain) {
+        long mid = r->begin + (r->end - r->begin) / 2;
+        RangeTask *upper = malloc(sizeof(RangeTask));
+        *upper = *r;
+        upper->begin = mid;
+        pool_submit(r->pool, r->grp, range_task, upper);
+        r->end = mid;
+    }
+    r->fn(r->ctx, r->begin, r->end, pool_worker_id());
+    free(r);
+}
+
+void pool_parallel_for(Pool *p, long n, long grain, RangeFn fn, void *ctx) {
+    if (n <= 0) return;
+    if (grain < 1) grain = 1;
+
+    TaskGroup grp;
+    pool_group_init(&grp);
+    RangeTask *r = malloc(sizeof(RangeTask));
+    *r = (RangeTask){ p, &grp, fn, ctx, 0, n, grain };
+    pool_submit(p, &grp, range_task, r);
+    pool_wait(p, &grp);
+}
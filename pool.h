@@ -0,0 +1,39 @@
+#ifndef TETRIS_POOL_H
+#define TETRIS_POOL_H
+
+#include <stdatomic.h>
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops
+// at the bottom, idle workers steal from the top of someone else's.
+// The thread that creates the pool is worker 0 and runs tasks while it
+// waits, so a pool of 1 runs everything inline.
+
+typedef struct Pool Pool;
+
+typedef void (*TaskFn)(void *arg);
+
+// Tracks a batch of tasks so callers only wait for their own work.
+typedef struct {
+    atomic_long pending;
+} TaskGroup;
+
+// Called on [begin, end) by whichever worker picked up that range.
+typedef void (*RangeFn)(void *ctx, long begin, long end, int worker);
+
+// threads <= 0 means one per online CPU.
+Pool *pool_create(int threads);
+void pool_destroy(Pool *p);
+int pool_size(const Pool *p);
+// Index of the calling worker, or -1 outside the pool.
+int pool_worker_id(void);
+
+void pool_group_init(TaskGroup *grp);
+void pool_submit(Pool *p, TaskGroup *grp, TaskFn fn, void *arg);
+// Runs queued tasks until every task in grp has finished.
+void pool_wait(Pool *p, TaskGroup *grp);
+
+// Splits [0, n) in halves down to `grain` items, letting idle workers steal
+// the halves, and returns when the whole range is done.
+void pool_parallel_for(Pool *p, long n, long grain, RangeFn fn, void *ctx);
+
+#endif
@@ -0,0 +1,713 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "render.h"
+
+// --- Styles ---
+enum {
+    ST_PLAIN,
+    ST_BORDER,
+    ST_EMPTY,
+    ST_GHOST,
+    ST_PIECE, // ST_PIECE + piece type for the seven piece colors
+    ST_ART = ST_PIECE + 7,
+    ST_YELLOW,
+    ST_DIM_YELLOW,
+    ST_GREEN,
+    ST_WHITE,
+    ST_DIM,
+    ST_TITLE_CYAN,
+    ST_TITLE_MAGENTA,
+    ST_COUNT
+};
+
+// Escape and glyph bytes are precomputed with their lengths, so a frame is
+// assembled without any formatting calls. Sequences are padded to a fixed
+// size and copied whole: short variable-length memcpy calls cost more than
+// the bytes they move.
+typedef struct {
+    char bytes[16];
+    uint8_t len;
+} Bytes;
+
+#define BYTES(str) { str, sizeof(str) - 1 }
+
+// Every entry starts from a reset, so switching styles never depends on
+// what was set before.
+static const Bytes SGR[ST_COUNT] = {
+    [ST_PLAIN] = BYTES(C_RESET),
+    [ST_BORDER] = BYTES(C_RESET C_BOLD FG_WHITE),
+    [ST_EMPTY] = BYTES(C_RESET C_DIM FG_GRAY),
+    [ST_GHOST] = BYTES(C_RESET C_DIM FG_WHITE),
+    [ST_PIECE + 0] = BYTES(C_RESET FG_CYAN),    // I
+    [ST_PIECE + 1] = BYTES(C_RESET FG_BLUE),    // J
+    [ST_PIECE + 2] = BYTES(C_RESET FG_YELLOW),  // L
+    [ST_PIECE + 3] = BYTES(C_RESET FG_WHITE),   // O
+    [ST_PIECE + 4] = BYTES(C_RESET FG_GREEN),   // S
+    [ST_PIECE + 5] = BYTES(C_RESET FG_MAGENTA), // T
+    [ST_PIECE + 6] = BYTES(C_RESET FG_RED),     // Z
+    [ST_ART] = BYTES(C_RESET C_BOLD FG_RED),
+    [ST_YELLOW] = BYTES(C_RESET FG_YELLOW),
+    [ST_DIM_YELLOW] = BYTES(C_RESET C_DIM FG_YELLOW),
+    [ST_GREEN] = BYTES(C_RESET FG_GREEN),
+    [ST_WHITE] = BYTES(C_RESET FG_WHITE),
+    [ST_DIM] = BYTES(C_RESET C_DIM),
+    [ST_TITLE_CYAN] = BYTES(C_RESET C_BOLD FG_CYAN),
+    [ST_TITLE_MAGENTA] = BYTES(C_RESET C_BOLD FG_MAGENTA),
+};
+
+// UTF-8 bytes of the glyphs above ASCII.
+typedef struct {
+    char bytes[4];
+    uint8_t len;
+} Glyph;
+
+static const Glyph GLYPHS[G_COUNT - G_BLOCK] = {
+    [G_BLOCK - G_BLOCK] = { "█", 3 },
+    [G_SHADE - G_BLOCK] = { "░", 3 },
+    [G_DOT - G_BLOCK] = { "·", 2 },
+    [G_HORZ - G_BLOCK] = { "═", 3 },
+    [G_VERT - G_BLOCK] = { "║", 3 },
+    [G_TL - G_BLOCK] = { "╔", 3 },
+    [G_TR - G_BLOCK] = { "╗", 3 },
+    [G_BL - G_BLOCK] = { "╚", 3 },
+    [G_BR - G_BLOCK] = { "╝", 3 },
+};
+
+// Each glyph repeated RUN_MAX times, so a run of equal cells (a block, a
+// border) is copied in 16-byte chunks. The tail is padding for the last one.
+#define RUN_MAX 64
+typedef struct {
+    uint8_t len; // Bytes per glyph
+    char run[RUN_MAX * 3 + 16];
+} GlyphRun;
+
+static GlyphRun glyph_runs[G_COUNT];
+static pthread_once_t glyph_runs_once = PTHREAD_ONCE_INIT;
+
+static void init_glyph_runs(void) {
+    for (int g = 0; g < G_COUNT; g++) {
+        Glyph one = { { (char)g }, 1 };
+        if (g >= G_BLOCK) one = GLYPHS[g - G_BLOCK];
+        glyph_runs[g].len = one.len;
+        for (int i = 0; i < RUN_MAX; i++) memcpy(glyph_runs[g].run + i * one.len, one.bytes, one.len);
+    }
+}
+
+static const char *GAME_OVER_ART[] = {
+    " GGG   AAA  M   M EEEE",
+    "G     A   A MM MM E   ",
+    "G  GG AAAAA M M M EEEE",
+    "G   G A   A M   M E   ",
+    " GGG  A   A M   M EEEE",
+    "",
+    " OOO  V   V EEEE RRRR ",
+    "O   O V   V E    R   R",
+    "O   O V   V EEEE RRRR ",
+    "O   O  V V  E    R R  ",
+    " OOO    V   EEEE R  RR"
+};
+static const int GAME_OVER_ART_H = 11;
+static const int GAME_OVER_ART_W = 22;
+
+// --- Screen ---
+// Four cells per store; a plain store loop does not vectorize at -O2.
+static void fill(Cell *dst, int n, int ch, int style) {
+    Cell c = CELL(ch, style);
+    uint64_t quad = c * 0x0001000100010001ull;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) memcpy(dst + i, &quad, sizeof(quad));
+    for (; i < n; i++) dst[i] = c;
+}
+
+void screen_init(Screen *s) {
+    memset(s, 0, sizeof(*s));
+    s->board_width = BOARD_WIDTH;
+    s->board_height = BOARD_HEIGHT;
+    s->cur_style = -1;
+    pthread_once(&glyph_runs_once, init_glyph_runs);
+}
+
+void screen_free(Screen *s) {
+    free(s->cells);
+    free(s->shown);
+    free(s->line);
+    free(s->blank);
+    free(s->row_id);
+    free(s->out);
+    screen_init(s);
+}
+
+// Side panel sections, in lines: a title, a blank line and the previews
+// one line apart; a title, a blank line and the 4x4 box; the four stats
+// with a blank line after the first pair and between the last two; the
+// controls or an overlay, then a blank line and the pause banner.
+#define PANEL_NEXT_H  (2 + NEXT_COUNT * 3 - 1)
+#define PANEL_HOLD_H  6
+#define PANEL_STATS_H 6
+#define PANEL_CTRL_H(lines) ((lines) + 2)
+// Lines the panel needs with at least one blank line between sections.
+#define PANEL_MIN_H   (PANEL_NEXT_H + PANEL_HOLD_H + PANEL_STATS_H + PANEL_CTRL_H(PANEL_OVERLAY_LINES) + 3)
+
+static Layout compute_layout(int term_w, int term_h, int board_width, int board_height) {
+    Layout L;
+    // --- Dynamic Scaling ---
+    int panel_width_chars = 26;
+    int extra_margin_w = 6;
+    int extra_margin_h = 3;
+
+    int available_h = term_h - extra_margin_h;
+    int available_w_for_board = term_w - panel_width_chars - extra_margin_w;
+
+    L.blk_h = available_h / board_height;
+    if (L.blk_h < 1) L.blk_h = 1;
+
+    int max_blk_h_by_width = available_w_for_board / (board_width * 2);
+    if (L.blk_h > max_blk_h_by_width) L.blk_h = max_blk_h_by_width;
+    if (L.blk_h < 1) L.blk_h = 1;
+
+    L.blk_w = L.blk_h * 2;
+    L.board_w = board_width * L.blk_w;
+    L.board_h = board_height * L.blk_h;
+
+    // A board too short for the panel leaves it clipped; the panel grows
+    // down past the board instead, as far as the terminal allows.
+    L.panel_h = term_h - 2 < PANEL_MIN_H ? term_h - 2 : PANEL_MIN_H;
+    if (L.panel_h < L.board_h) L.panel_h = L.board_h;
+
+    int total_content_w = L.board_w + 2 + 2 + panel_width_chars + 2;
+    int total_content_h = L.panel_h + 2;
+
+    L.top = (term_h - total_content_h) / 2;
+    if (L.top < 0) L.top = 0;
+    L.board_col = (term_w - total_content_w) / 2;
+    if (L.board_col < 0) L.board_col = 0;
+
+    L.panel_col = L.board_col + L.board_w + 4;
+    L.panel_right = L.board_col + L.board_w + 30;
+
+    L.row0 = L.top;
+    L.row1 = L.top + total_content_h < term_h ? L.top + total_content_h : term_h;
+    L.col0 = L.board_col;
+    L.col1 = L.panel_right + 1 < term_w ? L.panel_right + 1 : term_w;
+    return L;
+}
+
+static size_t out_need(const Screen *s) { return (size_t)s->w * s->h * 40 + 64; }
+
+static void setup(Screen *s, int w, int h) {
+    size_t n = (size_t)w * h;
+    s->w = w;
+    s->h = h;
+    s->layout = compute_layout(w, h, s->board_width, s->board_height);
+    s->cells = realloc(s->cells, n * sizeof(Cell));
+    s->shown = realloc(s->shown, n * sizeof(Cell));
+    s->line = realloc(s->line, (s->layout.panel_right + 1) * sizeof(Cell));
+    s->blank = realloc(s->blank, w * sizeof(Cell));
+    s->row_id = realloc(s->row_id, (size_t)h * SCREEN_SPANS * sizeof(uint32_t));
+    // Worst case per cell: a cursor move, an SGR change and a glyph.
+    s->out_cap = out_need(s);
+    s->out = realloc(s->out, s->out_cap);
+
+    // Only the frame's rectangle is ever drawn; the rest stays blank.
+    fill(s->cells, n, ' ', ST_PLAIN);
+    fill(s->shown, n, ' ', ST_PLAIN);
+    fill(s->blank, w, ' ', ST_PLAIN);
+    s->full_redraw = 1;
+}
+
+void screen_resize(Screen *s, int w, int h) {
+    if (w == s->w && h == s->h && s->cells) return;
+    setup(s, w, h);
+}
+
+void screen_swap_out(Screen *s, char **buf, size_t *cap) {
+    char *out = s->out;
+    size_t out_cap = s->out_cap;
+    s->out = *buf;
+    s->out_cap = *cap;
+    *buf = out;
+    *cap = out_cap;
+    s->out_len = 0;
+    if (s->out_cap < out_need(s)) {
+        s->out_cap = out_need(s);
+        s->out = realloc(s->out, s->out_cap);
+    }
+}
+
+// --- Composition ---
+static void put(Screen *s, int row, int col, int ch, int style) {
+    if (row < 0 || row >= s->h || col < 0 || col >= s->w) return;
+    s->cells[row * s->w + col] = CELL(ch, style);
+}
+
+// Writes text starting at col. Returns the column after the last char.
+static int put_text(Screen *s, int row, int col, int style, const char *text) {
+    for (; *text; text++) put(s, row, col++, (unsigned char)*text, style);
+    return col;
+}
+
+static int put_int(Screen *s, int row, int col, int style, int value) {
+    char buf[12];
+    char *p = buf + sizeof(buf) - 1;
+    unsigned int v = value < 0 ? -(unsigned int)value : (unsigned int)value;
+    *p = '\0';
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) *--p = '-';
+    return put_text(s, row, col, style, p);
+}
+
+// Copies line[from, to) into a screen row, clipped to the screen.
+static void blit(Screen *s, int row, const Cell *line, int from, int to) {
+    if (row < 0 || row >= s->h) return;
+    if (to > s->w) to = s->w;
+    if (to > from) memcpy(&s->cells[row * s->w + from], line + from, (to - from) * sizeof(Cell));
+}
+
+// One row of a preview piece in the side panel, drawn as in the 4x4 box.
+static void put_preview_row(Screen *s, int row, int col, int type, int box_row) {
+    const PieceShape *shape = &PIECES[type][0];
+    int y = box_row - shape->top;
+    if (y < 0 || y >= shape->height) return;
+    col += 4 + 2 * shape->left;
+    for (uint16_t bits = shape->rows[y]; bits; bits >>= 1, col += 2) {
+        if (bits & 1) {
+            put(s, row, col, G_BLOCK, ST_PIECE + type);
+            put(s, row, col + 1, G_BLOCK, ST_PIECE + type);
+        }
+    }
+}
+
+// A horizontal border row, board and panel together; only columns
+// [from, to) of it are drawn.
+static void compose_hborder(Screen *s, int row, int left, int right, int from, int to) {
+    const Layout *L = &s->layout;
+    Cell *line = s->line;
+    line[L->board_col] = CELL(left, ST_BORDER);
+    fill(line + L->board_col + 1, L->board_w, G_HORZ, ST_BORDER);
+    line[L->board_col + L->board_w + 1] = CELL(right, ST_BORDER);
+    fill(line + L->board_col + L->board_w + 2, 2, ' ', ST_PLAIN);
+    line[L->panel_col] = CELL(left, ST_BORDER);
+    fill(line + L->panel_col + 1, L->panel_right - L->panel_col - 1, G_HORZ, ST_BORDER);
+    line[L->panel_right] = CELL(right, ST_BORDER);
+    blit(s, row, line, from, to);
+}
+
+static void compose(Screen *s, const GameState *g, const RenderInfo *info) {
+    const Layout *L = &s->layout;
+    int blk_w = L->blk_w, blk_h = L->blk_h;
+    int top = L->top + 1; // Screen row of the first board line
+    int text_col = L->panel_col + 2;
+    Cell *line = s->line;
+
+    // Ghost Piece
+    int ghost_y = game_ghost_y(g);
+    const Tetromino *cur = &g->current_piece;
+    const PieceShape *shape = PIECE_SHAPE(cur);
+    int shown_high = g->score > info->high_score ? g->score : info->high_score;
+
+    // Active and ghost cells as row masks
+    uint16_t active[BOARD_MAX_HEIGHT] = {0}, ghost[BOARD_MAX_HEIGHT] = {0};
+    if (g->state == GAME_PLAY) {
+        for (int k = 0; k < 4; k++) {
+            int x = shape->cells[k].x + g->piece_x;
+            int y = shape->cells[k].y + g->piece_y;
+            int gy = shape->cells[k].y + ghost_y;
+            if (y >= 0 && y < g->height) active[y] |= 1u << x;
+            if (gy >= 0 && gy < g->height) ghost[gy] |= 1u << x;
+        }
+    }
+
+    // -- Borders --
+    int panel_from = L->board_col + L->board_w + 2;
+    compose_hborder(s, L->top, G_TL, G_TR, L->board_col, L->panel_right + 1);
+    compose_hborder(s, top + L->board_h, G_BL, G_BR, L->board_col, panel_from);
+    compose_hborder(s, top + L->panel_h, G_BL, G_BR, panel_from, L->panel_right + 1);
+
+    // -- Board --
+    // Every sub-row of a board line is the same except the one with the
+    // dots, so each line is formatted twice and copied blk_h times.
+    line[L->board_col] = CELL(G_VERT, ST_BORDER);
+    line[L->board_col + L->board_w + 1] = CELL(G_VERT, ST_BORDER);
+    for (int y = 0; y < g->height; y++) {
+        Cell *c = line + L->board_col + 1;
+        for (int x = 0; x < g->width; x++, c += blk_w) {
+            if (active[y] >> x & 1) fill(c, blk_w, G_BLOCK, ST_PIECE + cur->type);
+            else if (g->color[y][x] != 0) fill(c, blk_w, G_BLOCK, ST_PIECE + g->color[y][x] - 1);
+            else if (ghost[y] >> x & 1) fill(c, blk_w, G_SHADE, ST_GHOST);
+            else fill(c, blk_w, ' ', ST_EMPTY);
+        }
+        int dot_row = blk_h / 2;
+        for (int sub_y = 0; sub_y < blk_h; sub_y++) {
+            if (sub_y == dot_row) continue;
+            blit(s, top + y * blk_h + sub_y, line, L->board_col, L->board_col + L->board_w + 2);
+        }
+        c = line + L->board_col + 1;
+        for (int x = 0; x < g->width; x++, c += blk_w) {
+            if (CELL_CH(*c) == ' ') c[1] = CELL(G_DOT, ST_EMPTY);
+        }
+        blit(s, top + y * blk_h + dot_row, line, L->board_col, L->board_col + L->board_w + 2);
+    }
+
+    // -- Side Panel Background --
+    fill(line + panel_from, 2, ' ', ST_PLAIN);
+    line[L->panel_col] = CELL(G_VERT, ST_BORDER);
+    fill(line + L->panel_col + 1, L->panel_right - L->panel_col - 1, ' ', ST_PLAIN);
+    line[L->panel_right] = CELL(G_VERT, ST_BORDER);
+    for (int row = top; row < top + L->panel_h; row++) {
+        blit(s, row, line, panel_from, L->panel_right + 1);
+    }
+
+    int total_lines = L->panel_h;
+
+    // -- Game Over Overlay --
+    if (g->state == GAME_OVER) {
+        int center_y = g->height * blk_h / 2;
+        int start_art_y = center_y - GAME_OVER_ART_H / 2;
+        int pad_left = (L->board_w - GAME_OVER_ART_W) / 2;
+        if (pad_left < 0) pad_left = 0;
+
+        for (int i = 0; i < GAME_OVER_ART_H; i++) {
+            int art_line = start_art_y + i;
+            if (art_line < 0 || art_line >= L->board_h) continue;
+            for (int x = 0; x < L->board_w; x++) put(s, top + art_line, L->board_col + 1 + x, ' ', ST_PLAIN);
+            const char *art = GAME_OVER_ART[i];
+            for (int x = 0; art[x] && pad_left + x < L->board_w; x++)
+                put(s, top + art_line, L->board_col + 1 + pad_left + x, (unsigned char)art[x], ST_ART);
+        }
+    }
+
+    // -- Side Panel --
+    // The lines the sections need go first, then what is left is shared
+    // out above and between them.
+    static const char *controls[] = {
+        "Controls:", "Arrows/WASD", "Space : Drop", "C     : Hold", "P     : Pause"
+    };
+    int ctrl_lines = info->overlay ? info->overlay_lines : 5;
+    int content_h = PANEL_NEXT_H + PANEL_HOLD_H + PANEL_STATS_H + PANEL_CTRL_H(ctrl_lines);
+    int slack = total_lines - content_h;
+    if (slack < 0) slack = 0;
+
+    int gap = slack / 4;
+    if (gap == 0 && slack >= 3) gap = 1; // Sections apart before any margin
+    int y_next = slack - 3 * gap < gap ? slack - 3 * gap : gap;
+    int y_hold = y_next + PANEL_NEXT_H + gap;
+    int y_stats = y_hold + PANEL_HOLD_H + gap;
+    int y_ctrl = y_stats + PANEL_STATS_H + gap;
+
+#define PANEL_LINE(l) ((l) >= 0 && (l) < total_lines)
+    if (g->state == GAME_OVER) {
+        int go_y = total_lines / 2 - 4;
+        if (PANEL_LINE(go_y)) put_text(s, top + go_y, text_col, ST_ART, "GAME OVER");
+        if (PANEL_LINE(go_y + 2)) {
+            int c = put_text(s, top + go_y + 2, text_col, ST_PLAIN, "Final: ");
+            put_int(s, top + go_y + 2, c, ST_YELLOW, g->score);
+        }
+        if (PANEL_LINE(go_y + 3)) {
+            int c = put_text(s, top + go_y + 3, text_col, ST_PLAIN, "High : ");
+            put_int(s, top + go_y + 3, c, ST_YELLOW, shown_high);
+        }
+        if (PANEL_LINE(go_y + 5)) put_text(s, top + go_y + 5, text_col, ST_PLAIN, "R: Retry");
+        if (PANEL_LINE(go_y + 6)) put_text(s, top + go_y + 6, text_col, ST_PLAIN, "Q: Quit");
+    } else {
+        // NEXT SECTION
+        if (PANEL_LINE(y_next)) put_text(s, top + y_next, text_col, ST_TITLE_CYAN, "NEXT PIECE");
+        for (int slot = 0; slot < NEXT_COUNT; slot++) {
+            for (int p_row = 0; p_row < 2; p_row++) {
+                int line = y_next + 2 + slot * 3 + p_row;
+                if (PANEL_LINE(line)) put_preview_row(s, top + line, text_col, g->next_queue[slot].type, p_row);
+            }
+        }
+
+        // HOLD SECTION
+        if (PANEL_LINE(y_hold)) put_text(s, top + y_hold, text_col, ST_TITLE_MAGENTA, "HOLD (C)");
+        if (g->hold_idx != -1) {
+            for (int h_row = 0; h_row < 4; h_row++) {
+                int line = y_hold + 2 + h_row;
+                if (PANEL_LINE(line)) put_preview_row(s, top + line, text_col, g->hold_idx, h_row);
+            }
+        } else if (PANEL_LINE(y_hold + 3)) {
+            put_text(s, top + y_hold + 3, text_col, ST_DIM, "    Empty");
+        }
+
+        // STATS SECTION
+        if (PANEL_LINE(y_stats)) {
+            int c = put_text(s, top + y_stats, text_col, ST_PLAIN, "SCORE: ");
+            put_int(s, top + y_stats, c, ST_YELLOW, g->score);
+        }
+        if (PANEL_LINE(y_stats + 1)) {
+            int c = put_text(s, top + y_stats + 1, text_col, ST_DIM, "HIGH:  ");
+            put_int(s, top + y_stats + 1, c, ST_DIM_YELLOW, shown_high);
+        }
+        if (PANEL_LINE(y_stats + 3)) {
+            int c = put_text(s, top + y_stats + 3, text_col, ST_PLAIN, "LEVEL: ");
+            put_int(s, top + y_stats + 3, c, ST_GREEN, g->level);
+        }
+        if (PANEL_LINE(y_stats + 5)) {
+            int c = put_text(s, top + y_stats + 5, text_col, ST_PLAIN, "LINES: ");
+            put_int(s, top + y_stats + 5, c, ST_WHITE, g->lines_cleared_total);
+        }
+
+        // CONTROLS SECTION
+        if (info->overlay) {
+            for (int i = 0; i < ctrl_lines; i++) {
+                const char *text = info->overlay + (size_t)i * (PANEL_TEXT_COLS + 1);
+                if (PANEL_LINE(y_ctrl + i)) put_text(s, top + y_ctrl + i, text_col, ST_DIM, text);
+            }
+        } else {
+            for (int i = 0; i < ctrl_lines; i++) {
+                if (PANEL_LINE(y_ctrl + i)) put_text(s, top + y_ctrl + i, text_col, ST_DIM, controls[i]);
+            }
+        }
+        int y_paused = y_ctrl + ctrl_lines + 1;
+        if (info->paused && PANEL_LINE(y_paused)) put_text(s, top + y_paused, text_col, ST_ART, " PAUSED ");
+    }
+#undef PANEL_LINE
+}
+
+// --- Output ---
+// The emitters advance a local cursor into s->out. Going through s->out_len
+// instead would make every store a possible alias of the cell grids.
+static inline char *emit(char *o, const char *bytes, size_t len) {
+    memcpy(o, bytes, len);
+    return o + len;
+}
+
+// May store up to sizeof(Bytes) bytes; out_cap leaves room for that.
+static inline char *emit_bytes(char *o, const Bytes *b) {
+    memcpy(o, b->bytes, sizeof(b->bytes));
+    return o + b->len;
+}
+
+static char *emit_dec(char *o, int v) {
+    // Rows and columns almost always have one to three digits
+    if (v < 10) {
+        *o = '0' + v;
+        return o + 1;
+    }
+    if (v < 100) {
+        o[0] = '0' + v / 10;
+        o[1] = '0' + v % 10;
+        return o + 2;
+    }
+    if (v < 1000) {
+        o[0] = '0' + v / 100;
+        o[1] = '0' + v / 10 % 10;
+        o[2] = '0' + v % 10;
+        return o + 3;
+    }
+    char buf[12];
+    int n = 0;
+    do {
+        buf[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n > 0) *o++ = buf[--n];
+    return o;
+}
+
+static char *emit_move(char *o, int row, int col) {
+    *o++ = '\033';
+    *o++ = '[';
+    o = emit_dec(o, row + 1);
+    *o++ = ';';
+    o = emit_dec(o, col + 1);
+    *o++ = 'H';
+    return o;
+}
+
+// Relative move, so the bytes of a row do not depend on which row it is.
+static char *emit_forward(char *o, int n) {
+    *o++ = '\033';
+    *o++ = '[';
+    o = emit_dec(o, n);
+    *o++ = 'C';
+    return o;
+}
+
+// May store up to 15 bytes past the run; out_cap leaves room for that.
+static char *emit_run(char *o, int ch, int n) {
+    const GlyphRun *r = &glyph_runs[ch];
+    while (n > 0) {
+        int k = n < RUN_MAX ? n : RUN_MAX;
+        size_t bytes = (size_t)k * r->len;
+        for (size_t i = 0; i < bytes; i += 16) memcpy(o + i, r->run + i, 16);
+        o += bytes;
+        n -= k;
+    }
+    return o;
+}
+
+// The frame's columns split into spans, the board and the side panel, that
+// are diffed on their own. Board lines repeat a lot (every sub-row of a
+// line, all the empty lines), and a span equal to a recent one, before and
+// after, copies that span's bytes behind a fresh cursor move. Splitting
+// keeps a line of panel text from breaking the board's repetition.
+#define REUSE_ROWS 16
+
+// Bytes emitted for one span of one row.
+typedef struct {
+    int row; // -1 if the span was unchanged
+    uint64_t hash;
+    uint32_t old_id, new_id;
+    int first_col, first_style;
+    size_t rest_off, rest_len; // Everything after the first cell's SGR
+    int end_col, end_style;
+} SpanBytes;
+
+typedef struct {
+    Screen *s;
+    char *o;
+    int cur_row, cur_col, cur_style;
+    int cleared; // Screen was just cleared, so shown is stale
+} Flush;
+
+// Only a filter ahead of memcmp, so a rotate and XOR per 4-cell word does.
+// Two lanes halve the dependency chain.
+static uint64_t hash_cells(const Cell *c, int n) {
+    uint64_t a = n, b = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t q[2];
+        memcpy(q, c + i, sizeof(q));
+        a = (a << 7 | a >> 57) ^ q[0];
+        b = (b << 7 | b >> 57) ^ q[1];
+    }
+    for (; i < n; i++) a = (a << 7 | a >> 57) ^ c[i];
+    return a ^ (b << 32 | b >> 32);
+}
+
+// Brings columns [c0, c1) of a row up to date. recent holds the span's
+// last REUSE_ROWS rows, ids its content class per row.
+static void flush_span(Flush *f, SpanBytes *recent, uint32_t *ids, int row, int c0, int c1) {
+    Screen *s = f->s;
+    int n = c1 - c0;
+    const Cell *want = &s->cells[row * s->w];
+    const Cell *have = f->cleared ? s->blank : &s->shown[row * s->w];
+    SpanBytes *sb = &recent[row % REUSE_ROWS];
+    uint32_t old_id = ids[row];
+    // Unchanged spans keep their id and are never searched.
+    if (memcmp(want + c0, have + c0, n * sizeof(Cell)) == 0) {
+        sb->row = -1;
+        return;
+    }
+
+    const SpanBytes *same = NULL, *src = NULL;
+    uint64_t hash = hash_cells(want + c0, n);
+    for (int back = 1; back <= REUSE_ROWS && row - back >= s->layout.row0; back++) {
+        const SpanBytes *e = &recent[(row - back) % REUSE_ROWS];
+        if (e->row < 0 || e->hash != hash) continue;
+        if (same && (e->old_id != old_id || e->rest_len == 0)) continue;
+        if (memcmp(want + c0, &s->cells[e->row * s->w + c0], n * sizeof(Cell)) != 0) continue;
+        if (!same) same = e;
+        if (e->old_id == old_id && e->rest_len > 0) {
+            src = e;
+            break;
+        }
+    }
+    ids[row] = same ? same->new_id : s->next_id++;
+
+    char *o = f->o;
+    if (src) {
+        o = emit_move(o, row, src->first_col);
+        if (f->cur_style != src->first_style) o = emit_bytes(o, &SGR[src->first_style]);
+        // The source bytes lie behind o, so the copy never overlaps.
+        o = emit(o, s->out + src->rest_off, src->rest_len);
+        f->cur_style = src->end_style;
+        f->cur_row = src->end_col >= s->w ? -1 : row;
+        f->cur_col = src->end_col;
+        *sb = *src; // Same bytes, so it can serve as a source in turn
+    } else {
+        sb->first_col = -1;
+        for (int col = c0; col < c1;) {
+            if (want[col] == have[col]) {
+                col++;
+                continue;
+            }
+            if (row != f->cur_row) o = emit_move(o, row, col);
+            else if (col != f->cur_col) o = emit_forward(o, col - f->cur_col);
+            if (sb->first_col < 0) {
+                int style = CELL_STYLE(want[col]);
+                if (style != f->cur_style) o = emit_bytes(o, &SGR[style]);
+                f->cur_style = style;
+                sb->first_col = col;
+                sb->first_style = style;
+                sb->rest_off = o - s->out;
+            }
+            while (col < c1 && want[col] != have[col]) {
+                Cell c = want[col];
+                int end = col + 1;
+                while (end < c1 && want[end] == c && have[end] != c) end++;
+                int style = CELL_STYLE(c);
+                if (style != f->cur_style) {
+                    o = emit_bytes(o, &SGR[style]);
+                    f->cur_style = style;
+                }
+                o = emit_run(o, CELL_CH(c), end - col);
+                col = end;
+            }
+            f->cur_row = row;
+            f->cur_col = col;
+            // Past the last column the cursor sits in a pending wrap.
+            if (col >= s->w) f->cur_row = -1;
+        }
+        sb->rest_len = (size_t)(o - s->out) - sb->rest_off;
+        sb->end_col = f->cur_col;
+        sb->end_style = f->cur_style;
+    }
+    sb->row = row;
+    sb->hash = hash;
+    sb->old_id = old_id;
+    sb->new_id = ids[row];
+    f->o = o;
+}
+
+// Compares the composed frame with what the terminal shows and emits the
+// differences: a cursor move per run of changed cells, an SGR sequence per
+// style change and the glyphs.
+static void flush_diff(Screen *s) {
+    const Layout *L = &s->layout;
+    Flush f = { s, s->out, -1, -1, s->cur_style, s->full_redraw };
+    if (s->full_redraw) {
+        f.o = emit(f.o, C_RESET "\033[2J", sizeof(C_RESET "\033[2J") - 1);
+        memset(s->row_id, 0, (size_t)s->h * SCREEN_SPANS * sizeof(uint32_t));
+        s->next_id = 1;
+        f.cur_style = ST_PLAIN;
+        s->full_redraw = 0;
+    }
+
+    int split = L->board_col + L->board_w + 2;
+    if (split > L->col1) split = L->col1;
+    int bounds[SCREEN_SPANS + 1] = { L->col0, split, L->col1 };
+    SpanBytes recent[SCREEN_SPANS][REUSE_ROWS];
+    for (int row = L->row0; row < L->row1; row++) {
+        for (int span = 0; span < SCREEN_SPANS; span++) {
+            if (bounds[span + 1] > bounds[span])
+                flush_span(&f, recent[span], s->row_id + span * s->h, row, bounds[span], bounds[span + 1]);
+        }
+    }
+    // The terminal now shows the composed frame. compose() rewrites the
+    // whole frame rectangle, so the grids can trade places instead of
+    // being copied.
+    Cell *t = s->shown;
+    s->shown = s->cells;
+    s->cells = t;
+    s->cur_style = f.cur_style;
+    s->out_len = f.o - s->out;
+}
+
+size_t render_frame(Screen *s, const GameState *g, const RenderInfo *info) {
+    if (g->width != s->board_width || g->height != s->board_height) {
+        s->board_width = g->width;
+        s->board_height = g->height;
+        setup(s, s->w, s->h);
+    }
+    compose(s, g, info);
+    flush_diff(s);
+    return s->out_len;
+}
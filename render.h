@@ -0,0 +1,118 @@
+#ifndef TETRIS_RENDER_H
+#define TETRIS_RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// --- ANSI Colors & Styles ---
+#define C_RESET   "\033[0m"
+#define C_BOLD    "\033[1m"
+#define C_DIM     "\033[2m"
+#define C_REV     "\033[7m"
+
+// Foreground
+#define FG_BLACK  "\033[30m"
+#define FG_RED    "\033[31m"
+#define FG_GREEN  "\033[32m"
+#define FG_YELLOW "\033[33m"
+#define FG_BLUE   "\033[34m"
+#define FG_MAGENTA "\033[35m"
+#define FG_CYAN   "\033[36m"
+#define FG_WHITE  "\033[37m"
+#define FG_GRAY   "\033[90m"
+
+// Background
+#define BG_BLACK  "\033[40m"
+
+// --- Screen Model ---
+// The renderer composes each frame into a grid of cells, compares it with
+// the grid the terminal is already showing, and emits cursor moves and SGR
+// changes only for the cells that differ. An unchanged frame costs nothing.
+
+// Glyphs above ASCII. Every glyph is one terminal column wide.
+enum {
+    G_BLOCK = 128, // █
+    G_SHADE,       // ░
+    G_DOT,         // ·
+    G_HORZ,        // ═
+    G_VERT,        // ║
+    G_TL,          // ╔
+    G_TR,          // ╗
+    G_BL,          // ╚
+    G_BR,          // ╝
+    G_COUNT
+};
+
+// A cell packs its glyph (ASCII or one of the G_* glyphs) in the low byte
+// and its style, an index into the renderer's SGR table, in the high byte.
+typedef uint16_t Cell;
+#define CELL(ch, style) ((Cell)((ch) | (style) << 8))
+#define CELL_CH(c)      ((c) & 0xFF)
+#define CELL_STYLE(c)   ((c) >> 8)
+
+// Where the frame sits on a terminal of a given size.
+typedef struct {
+    int blk_w, blk_h;           // Terminal cells per board cell
+    int board_w, board_h;       // Board interior in terminal cells
+    int panel_h;                // Side panel interior rows, board_h or more
+    int top;                    // Row of the top border
+    int board_col;              // Column of the board's left border
+    int panel_col, panel_right; // Columns of the side panel's borders
+    int row0, row1, col0, col1; // On-screen part of the frame, [0, 1)
+} Layout;
+
+// Column spans diffed on their own: the board and the side panel.
+#define SCREEN_SPANS 2
+
+typedef struct {
+    int w, h;
+    int board_width, board_height; // Board size the layout is for
+    Layout layout;
+    Cell *cells; // Frame being composed
+    Cell *shown; // What the terminal displays right now
+    Cell *line;  // Scratch row for composing
+    Cell *blank; // One blank row, what any row shows after a clear
+    // Content class of each shown row, per span of columns: equal ids mean
+    // equal cells. Lets a row reuse the bytes emitted for an identical one.
+    uint32_t *row_id;
+    uint32_t next_id;
+    int full_redraw;
+    int cur_style; // SGR state left on the terminal, -1 if unknown
+
+    char *out; // Bytes produced by the last render_frame()
+    size_t out_len, out_cap;
+} Screen;
+
+// Widest text the side panel holds.
+#define PANEL_TEXT_COLS 22
+// Most lines an overlay may have.
+#define PANEL_OVERLAY_LINES 8
+
+// Front-end state shown in the side panel.
+typedef struct {
+    int high_score;
+    int paused;
+    // Lines drawn in place of the controls, PANEL_TEXT_COLS + 1 apart, at
+    // most PANEL_OVERLAY_LINES; NULL for the controls
+    const char *overlay;
+    int overlay_lines;
+} RenderInfo;
+
+void screen_init(Screen *s);
+void screen_free(Screen *s);
+// Sets the terminal size. A change forces a full redraw.
+void screen_resize(Screen *s, int w, int h);
+// Trades s->out, the last frame's bytes, for *buf of *cap bytes (NULL and
+// 0 for none), which the screen grows as it needs. The last frame can then
+// be written out while later ones are composed.
+void screen_swap_out(Screen *s, char **buf, size_t *cap);
+
+// Draws g into s->cells and leaves the bytes that bring the terminal up to
+// date in s->out. Returns the byte count, 0 when nothing changed. A game on
+// a board of another size than the last one is laid out anew and redrawn
+// in full.
+size_t render_frame(Screen *s, const GameState *g, const RenderInfo *info);
+
+#endif
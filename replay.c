@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "replay.h"
+
+// --- Recording ---
+struct ReplayWriter {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    // Filled by the game; the writer thread swaps it with `spare`
+    uint8_t *pending, *spare;
+    size_t len, cap, spare_cap;
+    int closing;
+    int failed;
+    uint64_t ticks; // Since the last record; game thread only
+};
+
+static int write_all(int fd, const uint8_t *p, size_t n) {
+    while (n > 0) {
+        ssize_t k = write(fd, p, n);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += k;
+        n -= k;
+    }
+    return 0;
+}
+
+static void *writer_main(void *arg) {
+    ReplayWriter *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->len == 0 && !w->closing) pthread_cond_wait(&w->wake, &w->lock);
+        if (w->len == 0) break; // Closing and drained
+
+        uint8_t *buf = w->pending;
+        size_t n = w->len, cap = w->cap;
+        w->pending = w->spare;
+        w->cap = w->spare_cap;
+        w->len = 0;
+        pthread_mutex_unlock(&w->lock);
+
+        int err = write_all(w->fd, buf, n);
+
+        pthread_mutex_lock(&w->lock);
+        w->spare = buf;
+        w->spare_cap = cap;
+        if (err) w->failed = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// Appends under the lock and wakes the writer if it was idle.
+static void append(ReplayWriter *w, const uint8_t *p, size_t n) {
+    pthread_mutex_lock(&w->lock);
+    if (w->len + n > w->cap) {
+        size_t cap = w->cap * 2;
+        while (cap < w->len + n) cap *= 2;
+        uint8_t *grown = realloc(w->pending, cap);
+        if (!grown) {
+            w->failed = 1;
+            pthread_mutex_unlock(&w->lock);
+            return;
+        }
+        w->pending = grown;
+        w->cap = cap;
+    }
+    int was_empty = w->len == 0;
+    memcpy(w->pending + w->len, p, n);
+    w->len += n;
+    if (was_empty) pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+}
+
+ReplayWriter *replay_writer_open(const char *path, uint64_t seed, int width, int height) {
+    ReplayWriter *w = calloc(1, sizeof(*w));
+    if (!w) return NULL;
+    w->cap = w->spare_cap = 4096;
+    w->pending = malloc(w->cap);
+    w->spare = malloc(w->spare_cap);
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (!w->pending || !w->spare || w->fd == -1) goto fail;
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    int rc = pthread_create(&w->thread, NULL, writer_main, w);
+    if (rc != 0) {
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->wake);
+        errno = rc;
+        goto fail;
+    }
+
+    uint8_t header[REPLAY_HEADER_SIZE];
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    for (int i = 0; i < 8; i++) header[5 + i] = (uint8_t)(seed >> (8 * i));
+    header[13] = (uint8_t)width;
+    header[14] = (uint8_t)height;
+    append(w, header, sizeof(header));
+    return w;
+
+fail: {
+        int err = errno;
+        if (w->fd != -1) {
+            close(w->fd);
+            unlink(path);
+        }
+        free(w->pending);
+        free(w->spare);
+        free(w);
+        errno = err;
+        return NULL;
+    }
+}
+
+void replay_record_tick(ReplayWriter *w) {
+    w->ticks++;
+}
+
+void replay_record(ReplayWriter *w, int code) {
+    uint8_t buf[10];
+    int n = 0;
+    uint64_t ticks = w->ticks > UINT64_MAX >> 3 ? UINT64_MAX >> 3 : w->ticks;
+    uint64_t v = ticks << 3 | (uint64_t)code;
+    while (v >= 0x80) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    w->ticks = 0;
+    append(w, buf, n);
+}
+
+int replay_writer_close(ReplayWriter *w) {
+    replay_record(w, REPLAY_END);
+
+    pthread_mutex_lock(&w->lock);
+    w->closing = 1;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    int failed = w->failed;
+    if (close(w->fd) == -1) failed = 1;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->wake);
+    free(w->pending);
+    free(w->spare);
+    free(w);
+    return failed ? -1 : 0;
+}
+
+// --- Playback ---
+int replay_reader_init(ReplayReader *r, const void *data, size_t len) {
+    const uint8_t *p = data;
+    if (len < 5 || memcmp(p, REPLAY_MAGIC, 4) != 0 || (p[4] != 2 && p[4] != REPLAY_VERSION)) return -1;
+    size_t header = p[4] == 2 ? 13 : REPLAY_HEADER_SIZE;
+    if (len < header) return -1;
+    r->seed = 0;
+    for (int i = 0; i < 8; i++) r->seed |= (uint64_t)p[5 + i] << (8 * i);
+    r->width = p[4] == 2 ? BOARD_WIDTH : p[13];
+    r->height = p[4] == 2 ? BOARD_HEIGHT : p[14];
+    r->p = p + header;
+    r->end = p + len;
+    return 0;
+}
+
+int replay_next(ReplayReader *r, ReplayRecord *rec) {
+    rec->ticks = 0;
+    rec->code = REPLAY_END;
+
+    const uint8_t *p = r->p;
+    uint64_t v;
+    if (p < r->end && *p < 0x80) {
+        v = *p++; // The common one-byte record
+    } else {
+        v = 0;
+        for (int shift = 0;; shift += 7) {
+            if (p == r->end || shift > 63) {
+                r->p = r->end; // Truncated
+                return 0;
+            }
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (b < 0x80) break;
+        }
+    }
+    r->p = p;
+    rec->ticks = v >> 3;
+    rec->code = (int)(v & 7);
+    if (rec->code == REPLAY_END) {
+        r->p = r->end;
+        return 0;
+    }
+    return 1;
+}
+
+void replay_apply(GameState *g, const ReplayRecord *rec) {
+    for (uint64_t t = 0; t < rec->ticks && g->state == GAME_PLAY; t++) game_tick(g);
+    if (rec->code == REPLAY_RESET) game_reset(g);
+    else if (rec->code != REPLAY_END) game_apply(g, (Action)rec->code);
+}
+
+int replay_run(const void *data, size_t len, ReplayGameFn fn, void *ctx) {
+    ReplayReader r;
+    if (replay_reader_init(&r, data, len) != 0) return -1;
+
+    GameState g;
+    if (game_init_sized(&g, r.seed, r.width, r.height) != 0) return -1;
+    int games = 1;
+    ReplayRecord rec;
+    int more;
+    do {
+        more = replay_next(&r, &rec);
+        if (rec.code == REPLAY_RESET) {
+            ReplayRecord ticks = { rec.ticks, REPLAY_END };
+            replay_apply(&g, &ticks);
+            if (fn) fn(ctx, &g);
+            game_reset(&g);
+            games++;
+        } else {
+            replay_apply(&g, &rec);
+        }
+    } while (more);
+    if (fn) fn(ctx, &g);
+    return games;
+}
@@ -0,0 +1,71 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+// Binary game logs. A game is fully determined by its seed and the order
+// of actions and gravity ticks, so that is all a log stores:
+//
+//   "TRPL" | version (1 byte) | seed (8 bytes, little endian)
+//   | board width, height (1 byte each)
+//   records: varint((ticks << 3) | code)
+//
+// `ticks` is the number of game_tick() calls since the previous record and
+// `code` an Action, REPLAY_RESET or REPLAY_END. A typical record is one
+// byte. Logs cut short by a crash still replay up to their last record.
+// Version 2 logs, from before boards had a size, play on the standard
+// board.
+
+#define REPLAY_MAGIC "TRPL"
+#define REPLAY_VERSION 3
+#define REPLAY_HEADER_SIZE 15
+
+#define REPLAY_END 0   // Trailing ticks, then stop
+#define REPLAY_RESET 7 // game_reset() after a game over
+_Static_assert((int)ACT_COUNT <= REPLAY_RESET, "actions must fit below REPLAY_RESET");
+
+typedef struct {
+    uint64_t ticks;
+    int code;
+} ReplayRecord;
+
+// --- Recording ---
+// Records are appended to memory and a background thread writes them out,
+// so the game loop never waits on the disk.
+typedef struct ReplayWriter ReplayWriter;
+
+// Creates `path` and writes the header of a game from game_init_sized(g,
+// seed, width, height). NULL with errno set on failure.
+ReplayWriter *replay_writer_open(const char *path, uint64_t seed, int width, int height);
+void replay_record_tick(ReplayWriter *w);
+void replay_record(ReplayWriter *w, int code);
+// Ends the log, waits for the writer and frees it. Returns -1 when any
+// write failed.
+int replay_writer_close(ReplayWriter *w);
+
+// --- Playback ---
+typedef struct {
+    const uint8_t *p, *end;
+    uint64_t seed;
+    int width, height;
+} ReplayReader;
+
+// Reads the header of a log held in memory. Returns -1 when it is not one.
+int replay_reader_init(ReplayReader *r, const void *data, size_t len);
+// Returns 0 at REPLAY_END, a truncated record or the end of the data.
+// The trailing ticks of REPLAY_END are still stored in rec.
+int replay_next(ReplayReader *r, ReplayRecord *rec);
+// Runs a record's ticks, then its action or reset.
+void replay_apply(GameState *g, const ReplayRecord *rec);
+
+// Called with every finished game: before each reset and at the end.
+typedef void (*ReplayGameFn)(void *ctx, const GameState *g);
+
+// Re-simulates a whole log without any pacing. Returns the number of
+// games, or -1 for a bad header or board size.
+int replay_run(const void *data, size_t len, ReplayGameFn fn, void *ctx);
+
+#endif
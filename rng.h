@@ -0,0 +1,53 @@
+#ifndef TETRIS_RNG_H
+#define TETRIS_RNG_H
+
+#include <stdint.h>
+
+// PCG32 (XSH-RR) on a fixed stream: 8 bytes of state, no hidden globals.
+// A given seed always yields the same sequence on every platform.
+
+typedef struct {
+    uint64_t state;
+} Rng;
+
+#define RNG_MULT 6364136223846793005ULL
+#define RNG_INC  1442695040888963407ULL
+
+static inline uint32_t rng_next(Rng *r) {
+    uint64_t old = r->state;
+    r->state = old * RNG_MULT + RNG_INC;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+static inline void rng_seed(Rng *r, uint64_t seed) {
+    r->state = 0;
+    rng_next(r);
+    r->state += seed;
+    rng_next(r);
+}
+
+// Uniform value in [0, bound), without modulo bias (Lemire's method).
+static inline uint32_t rng_below(Rng *r, uint32_t bound) {
+    uint64_t m = (uint64_t)rng_next(r) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (uint64_t)rng_next(r) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// SplitMix64 finalizer, for deriving independent seeds from one base seed.
+static inline uint64_t rng_mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+#endif
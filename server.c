@@ -0,0 +1,477 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "net.h"
+#include "server.h"
+
+#define TICK_US 5000 // Gravity runs on this grid while any match is on
+#define MAX_EVENTS 64
+// Room a client's output needs for one delta per seat, then NET_END. It
+// holds two, so a round can go out behind one the socket took only part of.
+#define ROUND_MAX(seats) ((seats) * NET_MSG_MAX + 3)
+// A client's copy of one seat's game, tail included
+#define SENT_BYTES(c) (sizeof(GameSnapshot) + SNAPSHOT_TAIL((c)->height) * sizeof(uint16_t))
+
+// Garbage rows a lock sends, by lines cleared.
+static const int ATTACK[5] = { 0, 0, 1, 2, 4 };
+
+typedef struct Client Client;
+typedef struct Match Match;
+
+typedef struct {
+    GameState game;
+    int64_t next_drop_us;
+    int incoming;   // Garbage rows owed, added by the next lock that clears nothing
+    Client *client; // NULL once it left
+    GameSnapshot fed; // As last published to ServeConfig.feed
+    uint16_t fed_tail[SNAPSHOT_TAIL_MAX];
+} Seat;
+
+struct Match {
+    uint32_t id;
+    int joined, clients, alive;
+    int started, over;
+    int dirty; // Has changes its clients were not sent; on Server.dirty
+    Match *next_dirty;
+    Match *prev, *next; // Started and not over
+    Rng rng;            // Garbage holes
+    Seat seat[];
+};
+
+// A client that falls behind gets no new deltas until its output drains,
+// then one delta per seat with everything it missed.
+struct Client {
+    int fd;
+    int seat;
+    Match *match;
+    int closing;     // Close once out is written
+    int polling_out; // EPOLLOUT armed
+    uint16_t out_len, out_sent;
+    uint16_t *sent_tail; // Tails of sent[], after it
+    uint8_t *out;        // 2 * ROUND_MAX(seats) bytes, after the tails
+    GameSnapshot sent[]; // Per seat, as of the last delta it got
+};
+
+typedef struct {
+    const ServeConfig *c;
+    int epfd, listen_fd, timer_fd, signal_fd;
+    Match *lobby;   // Filling up
+    Match *running; // Ticked
+    Match *dirty;
+    uint32_t matches;
+    int clients, peak_clients;
+    uint64_t accepted, finished, pieces, garbage, inputs, bytes_out, short_writes;
+    Histogram wake_us; // Work per epoll wakeup
+    Histogram tick_us; // One gravity pass over every match
+} Server;
+
+static int64_t mono_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void serve_config_init(ServeConfig *c) {
+    c->seats = 2;
+    c->width = BOARD_WIDTH;
+    c->height = BOARD_HEIGHT;
+    c->seed = 1;
+    c->feed = NULL;
+}
+
+static void set_events(Server *s, Client *c, int out) {
+    struct epoll_event ev = { .events = EPOLLIN | (out ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(s->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->polling_out = out;
+}
+
+static void arm_ticks(Server *s, int on) {
+    struct itimerspec its = { 0 };
+    if (on) {
+        its.it_interval.tv_nsec = TICK_US * 1000;
+        its.it_value = its.it_interval;
+    }
+    timerfd_settime(s->timer_fd, 0, &its, NULL);
+}
+
+static void mark_dirty(Server *s, Match *m) {
+    if (m->dirty) return;
+    m->dirty = 1;
+    m->next_dirty = s->dirty;
+    s->dirty = m;
+}
+
+// --- Matches ---
+static Match *new_match(Server *s) {
+    int seats = s->c->seats;
+    Match *m = calloc(1, sizeof(Match) + seats * sizeof(Seat));
+    if (!m) return NULL;
+    m->id = s->matches++;
+    rng_seed(&m->rng, ~rng_mix(s->c->seed + m->id));
+    return m;
+}
+
+static void start_match(Server *s, Match *m) {
+    const ServeConfig *c = s->c;
+    int64_t now = mono_us();
+    for (int i = 0; i < c->seats; i++) {
+        Seat *st = &m->seat[i];
+        game_init_sized(&st->game, rng_mix(c->seed + m->id), c->width, c->height);
+        st->next_drop_us = now + game_drop_interval_ms(&st->game) * 1000;
+
+        Client *cl = st->client;
+        uint8_t *o = cl->out + cl->out_len;
+        o[0] = 5;
+        o[1] = NET_START;
+        o[2] = (uint8_t)i;
+        o[3] = (uint8_t)c->seats;
+        o[4] = (uint8_t)c->width;
+        o[5] = (uint8_t)c->height;
+        cl->out_len += 6;
+    }
+    m->started = 1;
+    m->alive = c->seats;
+    m->next = s->running;
+    if (s->running) s->running->prev = m;
+    else arm_ticks(s, 1);
+    s->running = m;
+    s->lobby = NULL;
+    mark_dirty(s, m);
+}
+
+static void end_match(Server *s, Match *m) {
+    m->over = 1;
+    if (m->prev) m->prev->next = m->next;
+    else s->running = m->next;
+    if (m->next) m->next->prev = m->prev;
+    if (!s->running) arm_ticks(s, 0);
+    s->finished++;
+    mark_dirty(s, m);
+}
+
+static void knocked_out(Server *s, Match *m) {
+    if (--m->alive <= (s->c->seats > 1)) end_match(s, m);
+}
+
+static void locked(Server *s, Match *m, int i, int cleared) {
+    Seat *st = &m->seat[i];
+    s->pieces++;
+    int attack = ATTACK[cleared];
+    int cancel = attack < st->incoming ? attack : st->incoming;
+    st->incoming -= cancel;
+    attack -= cancel;
+    if (cleared == 0 && st->incoming > 0) {
+        game_add_garbage(&st->game, st->incoming, rng_below(&m->rng, st->game.width));
+        s->garbage += st->incoming;
+        st->incoming = 0;
+    }
+    for (int k = 1; k < s->c->seats && attack > 0; k++) {
+        Seat *target = &m->seat[(i + k) % s->c->seats];
+        if (target->game.state == GAME_PLAY) {
+            target->incoming += attack;
+            break;
+        }
+    }
+}
+
+// One input, or a gravity step for ACT_NONE, on seat i.
+static void play(Server *s, Match *m, int i, int action) {
+    GameState *g = &m->seat[i].game;
+    int pieces = g->pieces, lines = g->lines_cleared_total;
+    if (!(action == ACT_NONE ? game_tick(g) : game_apply(g, (Action)action))) return;
+    mark_dirty(s, m);
+    if (g->pieces != pieces) locked(s, m, i, g->lines_cleared_total - lines);
+    if (g->state != GAME_PLAY) knocked_out(s, m);
+}
+
+static void tick(Server *s) {
+    int64_t now = mono_us();
+    for (Match *m = s->running, *next; m; m = next) {
+        next = m->next; // m may end
+        for (int i = 0; i < s->c->seats && !m->over; i++) {
+            Seat *st = &m->seat[i];
+            if (st->game.state != GAME_PLAY || now < st->next_drop_us) continue;
+            play(s, m, i, ACT_NONE);
+            st->next_drop_us = now + game_drop_interval_ms(&st->game) * 1000;
+        }
+    }
+    hist_add(&s->tick_us, mono_us() - now);
+}
+
+// --- Clients ---
+static void drop_client(Server *s, Client *c) {
+    close(c->fd);
+    Match *m = c->match;
+    Seat *st = &m->seat[c->seat];
+    st->client = NULL;
+    m->clients--;
+    if (!m->started) {
+        // Leaving the lobby: the last one to join takes the free seat
+        int last = --m->joined;
+        if (c->seat != last) {
+            st->client = m->seat[last].client;
+            st->client->seat = c->seat;
+            m->seat[last].client = NULL;
+        }
+    } else if (!m->over && st->game.state == GAME_PLAY) {
+        st->game.state = GAME_OVER; // Forfeit
+        mark_dirty(s, m);
+        knocked_out(s, m);
+    }
+    if (m->over && m->clients == 0 && !m->dirty) free(m);
+    free(c);
+    s->clients--;
+}
+
+// Writes what the socket takes. Returns -1 when c is gone.
+static int client_write(Server *s, Client *c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->out_sent += n;
+            s->bytes_out += n;
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1 && errno == EAGAIN) {
+            s->short_writes++;
+            if (!c->polling_out) set_events(s, c, 1);
+            return 0;
+        } else {
+            drop_client(s, c);
+            return -1;
+        }
+    }
+    c->out_len = c->out_sent = 0;
+    if (c->polling_out) set_events(s, c, 0);
+    if (c->closing) {
+        drop_client(s, c);
+        return -1;
+    }
+    return 0;
+}
+
+static void accept_clients(Server *s) {
+    int seats = s->c->seats;
+    for (;;) {
+        int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails on Unix sockets, harmlessly
+
+        Client *c = calloc(1, sizeof(Client) + seats * SENT_BYTES(s->c) + 2 * ROUND_MAX(seats));
+        if (!s->lobby) s->lobby = new_match(s);
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (!c || !s->lobby || epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(c);
+            close(fd);
+            continue;
+        }
+        Match *m = s->lobby;
+        c->fd = fd;
+        c->sent_tail = (uint16_t *)&c->sent[seats];
+        c->out = (uint8_t *)(c->sent_tail + seats * SNAPSHOT_TAIL(s->c->height));
+        c->match = m;
+        c->seat = m->joined++;
+        m->seat[c->seat].client = c;
+        m->clients++;
+        s->accepted++;
+        if (++s->clients > s->peak_clients) s->peak_clients = s->clients;
+        if (m->joined == seats) start_match(s, m);
+    }
+}
+
+// One buffer per wakeup, so a client sending as fast as it can does not
+// hold up every other match; epoll reports the rest next time round.
+// Returns -1 when c is gone.
+static int client_read(Server *s, Client *c) {
+    uint8_t buf[256];
+    ssize_t n = read(c->fd, buf, sizeof(buf));
+    if (n == -1 && (errno == EINTR || errno == EAGAIN)) return 0;
+    if (n <= 0) {
+        drop_client(s, c);
+        return -1;
+    }
+    Match *m = c->match;
+    s->inputs += n;
+    for (ssize_t i = 0; i < n; i++) {
+        if (!m->started || m->over || m->seat[c->seat].game.state != GAME_PLAY) break;
+        if (buf[i] > ACT_NONE && buf[i] < ACT_COUNT) play(s, m, c->seat, buf[i]);
+    }
+    return 0;
+}
+
+// Sends every client of m that has room what changed since its last
+// round, and the result once the match is over. A client whose send fails
+// is dropped on the spot, and its forfeit can end the match halfway
+// through the seats. Marking m dirty does nothing while it is flushed, so
+// the flush goes round again to tell every seat how it ended.
+static void flush_match(Server *s, Match *m) {
+    int seats = s->c->seats;
+again:;
+    int over = m->over;
+    int height = s->c->height, tail_rows = SNAPSHOT_TAIL(height);
+    GameSnapshot now[NET_MAX_SEATS];
+    uint16_t now_tail[NET_MAX_SEATS][SNAPSHOT_TAIL_MAX];
+    for (int i = 0; i < seats; i++) {
+        Seat *st = &m->seat[i];
+        net_view(&st->game, &now[i], now_tail[i]);
+        if (s->c->feed && (memcmp(&now[i], &st->fed, sizeof(now[i])) != 0 ||
+                           memcmp(now_tail[i], st->fed_tail, tail_rows * sizeof(uint16_t)) != 0)) {
+            st->fed = now[i];
+            memcpy(st->fed_tail, now_tail[i], tail_rows * sizeof(uint16_t));
+            feed_publish(s->c->feed, m->id * seats + i, &st->game);
+        }
+    }
+    int winner = NET_NO_SEAT;
+    for (int i = 0; i < seats && over && seats > 1; i++) {
+        if (m->seat[i].game.state == GAME_PLAY) winner = i;
+    }
+
+    for (int i = 0; i < seats; i++) {
+        Client *c = m->seat[i].client;
+        if (!c || c->closing || 2 * ROUND_MAX(seats) - c->out_len < ROUND_MAX(seats)) continue;
+        for (int j = 0; j < seats; j++) {
+            c->out_len += net_put_delta(c->out + c->out_len, j, height, &c->sent[j], c->sent_tail + j * tail_rows,
+                                        &now[j], now_tail[j]);
+        }
+        if (over) {
+            uint8_t *o = c->out + c->out_len;
+            o[0] = 2;
+            o[1] = NET_END;
+            o[2] = (uint8_t)winner;
+            c->out_len += 3;
+            c->closing = 1;
+        }
+        client_write(s, c);
+    }
+    if (m->over && !over) goto again;
+}
+
+static void client_event(Server *s, Client *c, uint32_t events) {
+    if (events & EPOLLIN && client_read(s, c) != 0) return;
+    if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN)) {
+        drop_client(s, c);
+        return;
+    }
+    if (events & EPOLLOUT) {
+        Match *m = c->match;
+        // Caught up: send what it missed meanwhile
+        if (client_write(s, c) == 0 && c->out_len == 0) mark_dirty(s, m);
+    }
+}
+
+// --- Loop ---
+static void close_match(Server *s, Match *m) {
+    for (int i = 0; i < s->c->seats; i++) {
+        Client *c = m->seat[i].client;
+        if (!c) continue;
+        close(c->fd);
+        free(c);
+    }
+    free(m);
+}
+
+static void summary(const Server *s, int64_t elapsed_us) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    int seats = s->c->seats;
+    size_t per_match =
+        sizeof(Match) + seats * (sizeof(Seat) + sizeof(Client) + seats * SENT_BYTES(s->c) + 2 * ROUND_MAX(seats));
+    fprintf(stderr, "served %llu clients in %u matches (%llu finished), %d at once at most\n",
+            (unsigned long long)s->accepted, s->matches, (unsigned long long)s->finished, s->peak_clients);
+    fprintf(stderr, "%llu inputs, %llu pieces, %llu garbage rows, %.1f KiB out (%llu short writes)\n",
+            (unsigned long long)s->inputs, (unsigned long long)s->pieces, (unsigned long long)s->garbage,
+            s->bytes_out / 1024.0, (unsigned long long)s->short_writes);
+    fprintf(stderr, "%.2f s cpu in %.2f s, %zu bytes per match with its clients\n", cpu, elapsed_us / 1e6,
+            per_match);
+    hist_dump_header(stderr);
+    hist_dump(stderr, "wake_us", &s->wake_us);
+    hist_dump(stderr, "tick_us", &s->tick_us);
+}
+
+int serve(const char *addr, const ServeConfig *c) {
+    Server s = { .c = c };
+    s.listen_fd = net_listen(addr);
+    if (s.listen_fd == -1) return -1;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    s.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    s.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    s.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (s.signal_fd == -1 || s.timer_fd == -1 || s.epfd == -1) return -1;
+    int *fds[] = { &s.listen_fd, &s.timer_fd, &s.signal_fd };
+    for (int i = 0; i < 3; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = fds[i] };
+        if (epoll_ctl(s.epfd, EPOLL_CTL_ADD, *fds[i], &ev) != 0) return -1;
+    }
+    fprintf(stderr, "serving %d-player matches on %s\n", c->seats, addr);
+
+    int64_t start = mono_us();
+    struct epoll_event events[MAX_EVENTS];
+    for (int stop = 0; !stop;) {
+        int n = epoll_wait(s.epfd, events, MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int64_t t = mono_us();
+        for (int i = 0; i < n; i++) {
+            void *p = events[i].data.ptr;
+            if (p == &s.listen_fd) {
+                accept_clients(&s);
+            } else if (p == &s.timer_fd) {
+                uint64_t expirations;
+                if (read(s.timer_fd, &expirations, sizeof(expirations)) > 0) tick(&s);
+            } else if (p == &s.signal_fd) {
+                stop = 1;
+            } else {
+                client_event(&s, p, events[i].events);
+            }
+        }
+        while (s.dirty) {
+            Match *m = s.dirty;
+            s.dirty = m->next_dirty;
+            flush_match(&s, m); // Still marked, so leaving clients do not free it
+            m->dirty = 0;
+            if (m->over && m->clients == 0) free(m);
+        }
+        hist_add(&s.wake_us, mono_us() - t);
+    }
+
+    summary(&s, mono_us() - start);
+    // Matches still draining to their clients are left to the exit
+    while (s.running) {
+        Match *m = s.running;
+        s.running = m->next;
+        close_match(&s, m);
+    }
+    if (s.lobby) close_match(&s, s.lobby);
+    if (strncmp(addr, "unix:", 5) == 0) unlink(addr + 5);
+    close(s.listen_fd);
+    close(s.timer_fd);
+    close(s.signal_fd);
+    close(s.epfd);
+    return 0;
+}
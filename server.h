@@ -0,0 +1,27 @@
+#ifndef TETRIS_SERVER_H
+#define TETRIS_SERVER_H
+
+#include <stdint.h>
+
+#include "feed.h"
+
+// Versus server: matches of `seats` players over net.h's protocol, all on
+// one epoll loop. The server plays every game headless and is the only
+// authority on it; clients just send inputs. Players join the match that
+// is filling up and play when it is full. A lock that clears lines sends
+// garbage to the next seat still playing; the last one standing wins.
+typedef struct {
+    int seats;         // Players per match, 1 to NET_MAX_SEATS
+    int width, height; // Board of every game
+    uint64_t seed;     // Match k deals rng_mix(seed + k) to all its seats
+    Feed *feed;        // Gets seat i of match k as game k * seats + i; NULL for none
+} ServeConfig;
+
+// Two seats on the standard board, seed 1, no feed.
+void serve_config_init(ServeConfig *c);
+
+// Serves on addr (see net_listen()) until SIGINT or SIGTERM, then prints a
+// summary to stderr. Returns -1 with errno set when it cannot listen.
+int serve(const char *addr, const ServeConfig *c);
+
+#endif
@@ -0,0 +1,242 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ai.h"
+#include "engine.h"
+#include "pool.h"
+
+// Headless batch runner: plays N independent games across a work-stealing
+// pool and reports aggregate stats. Game i always uses the same seed, so
+// per-game results do not depend on the thread count.
+
+typedef struct {
+    int score;
+    int lines;
+    int level;
+    int pieces;
+} GameResult;
+
+// Plays one piece: issues actions until the current piece locks. `ai` is
+// the calling worker's own slot, for policies that search.
+typedef void (*Policy)(GameState *g, Rng *rng, Ai **ai);
+
+typedef struct {
+    GameResult *results;
+    uint64_t base_seed;
+    int max_pieces;
+    int width, height;
+    Policy policy;
+    Ai **ai; // Per worker of the running batch, created on first use
+} SimCtx;
+
+// --- Policies ---
+static void policy_drop(GameState *g, Rng *rng, Ai **ai) {
+    (void)rng;
+    (void)ai;
+    game_apply(g, ACT_HARD_DROP);
+}
+
+static void policy_random(GameState *g, Rng *rng, Ai **ai) {
+    (void)ai;
+    if (rng_below(rng, 8) == 0) game_apply(g, ACT_HOLD);
+    int turns = rng_below(rng, 4);
+    for (int i = 0; i < turns; i++) game_apply(g, ACT_ROTATE);
+    int shift = (int)rng_below(rng, g->width) - g->width / 2;
+    Action a = shift < 0 ? ACT_LEFT : ACT_RIGHT;
+    for (int i = 0; i < abs(shift); i++) game_apply(g, a);
+    game_apply(g, ACT_HARD_DROP);
+}
+
+// The autoplayer with its default search, one per worker thread. Games
+// already run in parallel, so each search runs inline.
+static void policy_ai(GameState *g, Rng *rng, Ai **ai) {
+    (void)rng;
+    if (!*ai) {
+        AiConfig c;
+        ai_config_init(&c);
+        *ai = ai_create(&c);
+        if (!*ai) abort();
+    }
+    Placement p;
+    if (!ai_choose(*ai, g, &p) || !game_place(g, &p)) game_apply(g, ACT_HARD_DROP);
+}
+
+static const struct {
+    const char *name;
+    Policy fn;
+} POLICIES[] = {
+    { "drop", policy_drop },
+    { "random", policy_random },
+    { "ai", policy_ai },
+};
+#define POLICY_COUNT (int)(sizeof(POLICIES) / sizeof(POLICIES[0]))
+
+// --- Simulation ---
+
+static void run_games(void *arg, long begin, long end, int worker) {
+    SimCtx *ctx = arg;
+    GameState g;
+    for (long i = begin; i < end; i++) {
+        uint64_t seed = rng_mix(ctx->base_seed + (uint64_t)i);
+        Rng policy_rng;
+        rng_seed(&policy_rng, rng_mix(seed));
+        game_init_sized(&g, seed, ctx->width, ctx->height);
+        while (g.state == GAME_PLAY && g.pieces < ctx->max_pieces) ctx->policy(&g, &policy_rng, &ctx->ai[worker]);
+
+        GameResult *r = &ctx->results[i];
+        r->score = g.score;
+        r->lines = g.lines_cleared_total;
+        r->level = g.level;
+        r->pieces = g.pieces;
+    }
+}
+
+// --- Stats ---
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_dist(const char *name, int *v, long n) {
+    double sum = 0;
+    for (long i = 0; i < n; i++) sum += v[i];
+    qsort(v, n, sizeof(int), cmp_int);
+    printf("%-7s mean %10.1f  p50 %8d  p90 %8d  p99 %8d  max %8d\n",
+           name, sum / n, v[n / 2], v[n * 90 / 100], v[n * 99 / 100], v[n - 1]);
+}
+
+static int online_cpus() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Runs the whole batch on `threads` workers. Returns wall time in seconds.
+static double run_batch(SimCtx *ctx, long games, int threads, long grain) {
+    Pool *pool = pool_create(threads);
+    int workers = pool_size(pool);
+    ctx->ai = calloc(workers, sizeof(Ai *));
+    if (!ctx->ai) abort();
+    double start = now_sec();
+    pool_parallel_for(pool, games, grain, run_games, ctx);
+    double elapsed = now_sec() - start;
+    pool_destroy(pool);
+    for (int i = 0; i < workers; i++) ai_destroy(ctx->ai[i]);
+    free(ctx->ai);
+    ctx->ai = NULL;
+    return elapsed;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --games N        games to play (default 1000)\n"
+            "  -j, --threads N      worker threads (default: all cores)\n"
+            "  --seed S             base seed; game i gets a seed derived from S and i\n"
+            "  --policy NAME        drop | random | ai (default random)\n"
+            "  --max-pieces N       stop each game after N pieces (default 1000)\n"
+            "  --width N, --height N  board size (default %dx%d)\n"
+            "  --grain N            games per stolen work item (default 16)\n"
+            "  --scaling            rerun the batch at 1, 2, 4, ... threads\n",
+            prog, BOARD_WIDTH, BOARD_HEIGHT);
+}
+
+int main(int argc, char *argv[]) {
+    long games = 1000;
+    int threads = 0;
+    uint64_t seed = 1;
+    int max_pieces = 1000;
+    int width = BOARD_WIDTH, height = BOARD_HEIGHT;
+    long grain = 16;
+    int scaling = 0;
+    Policy policy = policy_random;
+    const char *policy_name = "random";
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if ((!strcmp(arg, "-n") || !strcmp(arg, "--games")) && val) { games = atol(val); i++; }
+        else if ((!strcmp(arg, "-j") || !strcmp(arg, "--threads")) && val) { threads = atoi(val); i++; }
+        else if (!strcmp(arg, "--seed") && val) { seed = strtoull(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "--max-pieces") && val) { max_pieces = atoi(val); i++; }
+        else if (!strcmp(arg, "--width") && val) { width = atoi(val); i++; }
+        else if (!strcmp(arg, "--height") && val) { height = atoi(val); i++; }
+        else if (!strcmp(arg, "--grain") && val) { grain = atol(val); i++; }
+        else if (!strcmp(arg, "--scaling")) scaling = 1;
+        else if (!strcmp(arg, "--policy") && val) {
+            policy = NULL;
+            for (int k = 0; k < POLICY_COUNT; k++) {
+                if (!strcmp(val, POLICIES[k].name)) policy = POLICIES[k].fn;
+            }
+            if (!policy) {
+                fprintf(stderr, "Unknown policy: %s\n", val);
+                return 1;
+            }
+            policy_name = val;
+            i++;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (games <= 0 || max_pieces <= 0 || width < BOARD_MIN_SIZE || width > BOARD_MAX_WIDTH ||
+        height < BOARD_MIN_SIZE || height > BOARD_MAX_HEIGHT) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SimCtx ctx = { calloc(games, sizeof(GameResult)), seed, max_pieces, width, height, policy, NULL };
+    if (!ctx.results) {
+        fprintf(stderr, "Out of memory for %ld games\n", games);
+        return 1;
+    }
+
+    if (scaling) {
+        int max_threads = threads > 0 ? threads : online_cpus();
+        printf("%8s %12s %14s %9s\n", "threads", "seconds", "pieces/s", "speedup");
+        double base = 0;
+        for (int t = 1;; t = t * 2 < max_threads ? t * 2 : max_threads) {
+            double secs = run_batch(&ctx, games, t, grain);
+            long pieces = 0;
+            for (long i = 0; i < games; i++) pieces += ctx.results[i].pieces;
+            if (t == 1) base = secs;
+            printf("%8d %12.3f %14.0f %8.2fx\n", t, secs, pieces / secs, base / secs);
+            if (t == max_threads) break;
+        }
+    }
+
+    double secs = run_batch(&ctx, games, threads, grain);
+
+    long total_pieces = 0;
+    int *scores = malloc(games * sizeof(int));
+    int *lines = malloc(games * sizeof(int));
+    int *levels = malloc(games * sizeof(int));
+    for (long i = 0; i < games; i++) {
+        scores[i] = ctx.results[i].score;
+        lines[i] = ctx.results[i].lines;
+        levels[i] = ctx.results[i].level;
+        total_pieces += ctx.results[i].pieces;
+    }
+
+    printf("games %ld  policy %s  seed %llu  max-pieces %d  board %dx%d  threads %d\n", games, policy_name,
+           (unsigned long long)seed, max_pieces, width, height, threads > 0 ? threads : online_cpus());
+    printf("time %.3f s  %.0f games/s  %.0f pieces/s\n", secs, games / secs, total_pieces / secs);
+    print_dist("score", scores, games);
+    print_dist("lines", lines, games);
+    print_dist("level", levels, games);
+
+    free(scores);
+    free(lines);
+    free(levels);
+    free(ctx.results);
+    return 0;
+}
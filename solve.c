@@ -0,0 +1,288 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "pool.h"
+#include "replay.h"
+#include "solver.h"
+#include "tt.h"
+
+// Puzzle solver front end: reads puzzle files (or deals from a seed on an
+// empty board), searches each one and prints the solutions as key
+// sequences. Exits 1 when any puzzle has no solution.
+
+static const char PIECE_NAMES[] = "IJLOSTZ";
+
+typedef struct {
+    GameState start;
+    uint8_t next[SOLVE_MAX_PIECES + 1];
+    int n_next;
+    int dealt; // Pieces came from the seed onto an empty board
+} Puzzle;
+
+typedef struct {
+    const Puzzle *pz;
+    int index;
+    ReplayWriter *recorder;
+    int recorded;
+} Output;
+
+// --- Puzzles ---
+static int piece_type(int c) {
+    const char *p = c ? strchr(PIECE_NAMES, c) : NULL;
+    return p ? (int)(p - PIECE_NAMES) : -1;
+}
+
+// The seed's own sequence: the hold slot is emptied before each hold, so
+// every hold just draws the next piece.
+static void deal(Puzzle *pz, uint64_t seed, int n, int width, int height) {
+    game_init_sized(&pz->start, seed, width, height);
+    GameState g = pz->start;
+    for (int i = 0; i < n; i++) {
+        g.hold_idx = -1;
+        g.hold_locked = 0;
+        game_apply(&g, ACT_HOLD);
+        pz->next[i] = g.current_piece.type;
+    }
+    pz->n_next = n;
+    pz->dealt = 1;
+}
+
+// Text format, one item per line:
+//   # comment
+//   size 10 20       optional board width and height, before anything else
+//   pieces TSZO...   current piece first, then the ones that follow
+//   hold T           optional
+//   ..XXXX..XX       board rows, top to bottom, stacked on the floor;
+//                    '.' is empty, anything else is filled
+// Without a pieces line the pieces are dealt from the seed.
+static int load_puzzle(const char *path, Puzzle *pz, uint64_t seed, int budget) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    deal(pz, seed, budget + 1, BOARD_WIDTH, BOARD_HEIGHT);
+    pz->dealt = 0;
+    uint16_t rows[BOARD_MAX_HEIGHT];
+    int n_rows = 0, have_pieces = 0, have_any = 0, line_no = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+        if (!strncmp(line, "size ", 5)) {
+            int w, h;
+            char end;
+            if (have_any || sscanf(line + 5, "%d %d %c", &w, &h, &end) != 2 || w < BOARD_MIN_SIZE ||
+                w > BOARD_MAX_WIDTH || h < BOARD_MIN_SIZE || h > BOARD_MAX_HEIGHT) goto bad;
+            deal(pz, seed, budget + 1, w, h);
+            pz->dealt = 0;
+        } else if (!strncmp(line, "pieces ", 7)) {
+            const char *p = line + 7;
+            int n = 0;
+            for (; *p && n <= SOLVE_MAX_PIECES + 1; p++) {
+                int t = piece_type(*p);
+                if (t < 0) break;
+                if (n == 0) pz->start.current_piece.type = (uint8_t)t;
+                else pz->next[n - 1] = (uint8_t)t;
+                n++;
+            }
+            if (*p || n == 0) goto bad;
+            pz->n_next = n - 1;
+            have_pieces = 1;
+        } else if (!strncmp(line, "hold ", 5)) {
+            int t = piece_type(line[5]);
+            if (t < 0 || line[6]) goto bad;
+            pz->start.hold_idx = t;
+        } else {
+            if (strlen(line) != pz->start.width || n_rows == pz->start.height) goto bad;
+            uint16_t row = 0;
+            for (int x = 0; x < pz->start.width; x++) {
+                if (line[x] != '.') row |= 1u << x;
+            }
+            rows[n_rows++] = row;
+        }
+        have_any = 1;
+    }
+    fclose(f);
+
+    GameState *g = &pz->start;
+    for (int i = 0; i < n_rows; i++) {
+        int y = g->height - n_rows + i;
+        g->rows[y] = rows[i];
+        for (int x = 0; x < g->width; x++) {
+            g->color[y][x] = rows[i] >> x & 1 ? PIECE_COLOR(PIECE_O) : 0;
+        }
+    }
+    game_update_heights(g);
+    game_rehash(g);
+    g->current_piece.rot = 0;
+    if (check_collision(g, &g->current_piece, g->piece_x, g->piece_y)) {
+        fprintf(stderr, "%s: no room for the first piece\n", path);
+        return -1;
+    }
+    pz->dealt = !have_pieces && n_rows == 0 && g->hold_idx < 0;
+    return 0;
+
+bad:
+    fclose(f);
+    fprintf(stderr, "%s:%d: bad puzzle line\n", path, line_no);
+    return -1;
+}
+
+// --- Output ---
+static char action_key(int a) {
+    switch (a) {
+        case ACT_LEFT: return 'a';
+        case ACT_RIGHT: return 'd';
+        case ACT_SOFT_DROP: return 's';
+        case ACT_ROTATE: return 'w';
+        case ACT_HOLD: return 'c';
+        default: return '?';
+    }
+}
+
+// One word of keys per placement, each followed by a hard drop; "-" is a
+// piece dropped straight from where it spawned.
+static void print_solution(void *ctx, const Solution *s) {
+    Output *out = ctx;
+    MovePath paths[SOLVE_MAX_PIECES];
+    int n = solution_paths(&out->pz->start, out->pz->next, out->pz->n_next, s, paths);
+    printf("  %d:", ++out->index);
+    for (int i = 0; i < n; i++) {
+        putchar(' ');
+        if (paths[i].len == 1) putchar('-');
+        for (int k = 0; k + 1 < paths[i].len; k++) putchar(action_key(paths[i].actions[k]));
+    }
+    if (n < s->count) printf(" (path too long for piece %d)", n + 1);
+    putchar('\n');
+
+    if (out->recorder && !out->recorded && n == s->count) {
+        for (int i = 0; i < n; i++) {
+            for (int k = 0; k < paths[i].len; k++) replay_record(out->recorder, paths[i].actions[k]);
+        }
+        out->recorded = 1; // One game per log
+    }
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [PUZZLE...]\n"
+            "  --seed S             deal pieces from seed S (default 1) when a puzzle lists none\n"
+            "  --pieces N           placements allowed (default 10, at most %d)\n"
+            "  --lines N            lines to clear (default 0: perfect clear)\n"
+            "  --max-height N       highest the stack may get (default 4)\n"
+            "  --width N, --height N  board of a seed-dealt empty board (default %dx%d)\n"
+            "  --solutions N        solutions to print per puzzle (default 1)\n"
+            "  -j, --threads N      worker threads (default: all cores)\n"
+            "  --tt MB              table of failed states (default 64, 0 for none)\n"
+            "  --record FILE        save the first solution as a replay log (seed deals only)\n"
+            "With no PUZZLE, solves an empty board dealt from the seed.\n",
+            prog, SOLVE_MAX_PIECES, BOARD_WIDTH, BOARD_HEIGHT);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t seed = 1;
+    int threads = 0;
+    int tt_mb = 64;
+    int width = BOARD_WIDTH, height = BOARD_HEIGHT;
+    const char *record_path = NULL;
+    const char *puzzles[argc];
+    int n_puzzles = 0;
+    SolveConfig c;
+    solve_config_init(&c);
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--seed") && val) { seed = strtoull(val, NULL, 0); i++; }
+        else if (!strcmp(arg, "--pieces") && val) { c.pieces = atoi(val); i++; }
+        else if (!strcmp(arg, "--lines") && val) { c.lines = atoi(val); i++; }
+        else if (!strcmp(arg, "--max-height") && val) { c.max_height = atoi(val); i++; }
+        else if (!strcmp(arg, "--width") && val) { width = atoi(val); i++; }
+        else if (!strcmp(arg, "--height") && val) { height = atoi(val); i++; }
+        else if (!strcmp(arg, "--solutions") && val) { c.max_solutions = atoi(val); i++; }
+        else if ((!strcmp(arg, "-j") || !strcmp(arg, "--threads")) && val) { threads = atoi(val); i++; }
+        else if (!strcmp(arg, "--tt") && val) { tt_mb = atoi(val); i++; }
+        else if (!strcmp(arg, "--record") && val) { record_path = val; i++; }
+        else if (arg[0] != '-') puzzles[n_puzzles++] = arg;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (c.pieces < 1 || c.pieces > SOLVE_MAX_PIECES || c.lines < 0 || c.max_height < 1 || c.max_solutions < 1 ||
+        (record_path && n_puzzles > 1) || width < BOARD_MIN_SIZE || width > BOARD_MAX_WIDTH ||
+        height < BOARD_MIN_SIZE || height > BOARD_MAX_HEIGHT) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Pool *pool = pool_create(threads);
+    c.pool = pool_size(pool) > 1 ? pool : NULL;
+    c.tt = tt_mb > 0 ? tt_create((size_t)tt_mb << 20) : NULL;
+    if (tt_mb > 0 && !c.tt) {
+        fprintf(stderr, "Out of memory for the table\n");
+        return 1;
+    }
+
+    int unsolved = 0;
+    for (int p = 0; p < (n_puzzles ? n_puzzles : 1); p++) {
+        Puzzle pz;
+        if (n_puzzles) {
+            if (load_puzzle(puzzles[p], &pz, seed, c.pieces) != 0) return 1;
+        } else {
+            deal(&pz, seed, c.pieces + 1, width, height);
+        }
+
+        Output out = { &pz, 0, NULL, 0 };
+        if (record_path) {
+            if (!pz.dealt) {
+                fprintf(stderr, "--record needs a puzzle dealt from the seed on an empty board\n");
+                return 1;
+            }
+            out.recorder = replay_writer_open(record_path, seed, pz.start.width, pz.start.height);
+            if (!out.recorder) {
+                perror(record_path);
+                return 1;
+            }
+        }
+
+        printf("%s\n", n_puzzles ? puzzles[p] : "empty board");
+        if (c.tt) tt_clear(c.tt);
+        SolveStats st;
+        double start = now_sec();
+        int found = solve(&pz.start, pz.next, pz.n_next, &c, print_solution, &out, &st);
+        double secs = now_sec() - start;
+        if (found < 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        if (found == 0) {
+            printf("  no solution\n");
+            unsolved++;
+        }
+        printf("  %.3f s  %llu nodes (%.0f/s)  %llu pruned  %llu transpositions\n", secs,
+               (unsigned long long)st.nodes, st.nodes / (secs > 0 ? secs : 1e-9),
+               (unsigned long long)st.pruned, (unsigned long long)st.transpositions);
+
+        if (out.recorder && replay_writer_close(out.recorder) != 0) {
+            fprintf(stderr, "%s: could not write the replay log\n", record_path);
+            return 1;
+        }
+    }
+
+    tt_destroy(c.tt);
+    pool_destroy(pool);
+    return unsolved > 0;
+}
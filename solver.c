@@ -0,0 +1,326 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "solver.h"
+
+#define SPLIT_TASKS 256 // Subtrees to cut the tree into before the workers start
+
+typedef struct {
+    GameState g;
+    int used; // Pieces of `next` drawn so far
+    int gap;  // shortfall()
+    Solution path;
+} Task;
+
+typedef struct {
+    uint64_t nodes, pruned, transpositions;
+} Counts;
+
+typedef struct {
+    const SolveConfig *c;
+    const uint8_t *next;
+    int n_next;
+    int base_lines;
+    SolveFn fn;
+    void *ctx;
+    Task *tasks;
+    pthread_mutex_t lock;
+    int found;
+    _Atomic int stop;
+    _Atomic uint64_t nodes, pruned, transpositions;
+} Search;
+
+void solve_config_init(SolveConfig *c) {
+    c->pieces = 10;
+    c->lines = 0;
+    c->max_height = 4;
+    c->max_solutions = 1;
+    c->pool = NULL;
+    c->tt = NULL;
+}
+
+// --- Puzzle State ---
+// The preview comes from the puzzle's sequence rather than the bag. Past
+// its end the slots hold a stand-in that remaining() never lets into play.
+static void feed(const Search *s, GameState *g, int used) {
+    for (int i = 0; i < NEXT_COUNT; i++) {
+        int k = used + i;
+        g->next_queue[i].type = k < s->n_next ? s->next[k] : PIECE_I;
+        g->next_queue[i].rot = 0;
+    }
+}
+
+// Placements still allowed: each one draws a new piece, so the sequence
+// runs out one placement after its last piece was drawn.
+static int remaining(const Search *s, int used, int depth) {
+    int left = s->c->pieces - depth;
+    int have = used <= s->n_next ? 1 + s->n_next - used : 0;
+    return left < have ? left : have;
+}
+
+static int reached(const Search *s, const GameState *g) {
+    if (s->c->lines > 0) return g->lines_cleared_total - s->base_lines >= s->c->lines;
+    if (g->lines_cleared_total == s->base_lines) return 0;
+    for (int x = 0; x < g->width; x++) {
+        if (g->col_height[x]) return 0;
+    }
+    return 1;
+}
+
+// Empty cells that still have to be filled before g reaches the goal, at
+// the least, or -1 when no sequence of pieces can get there. Every row that
+// has to clear needs its gaps filled; a perfect clear also needs the cells
+// to come out at a multiple of the width, four at a time, with no more
+// than cells_left more cells.
+static int shortfall(const Search *s, const GameState *g, int cells_left) {
+    int width = g->width, height = 0;
+    for (int x = 0; x < width; x++) {
+        if (g->col_height[x] > height) height = g->col_height[x];
+    }
+    if (height > s->c->max_height) return -1;
+
+    if (s->c->lines == 0) {
+        int cells = 0, rows = 0;
+        for (int y = g->height - height; y < g->height; y++) {
+            cells += __builtin_popcount(g->rows[y]);
+            rows += g->rows[y] != 0;
+        }
+        if (width % 2 == 0 && cells & 1) return -1; // Even widths keep the parity
+        for (int lines = rows; lines * width - cells <= cells_left; lines++) {
+            if ((lines * width - cells) % 4 == 0) return lines * width - cells;
+        }
+        return -1;
+    }
+
+    // Cheapest rows to finish, from a count of rows by empty cells. Rows
+    // above the height limit can only come in empty.
+    int need = s->c->lines - (g->lines_cleared_total - s->base_lines);
+    int band = s->c->max_height < g->height ? s->c->max_height : g->height;
+    int rows_by_gap[BOARD_MAX_WIDTH + 1] = { 0 };
+    for (int y = g->height - band; y < g->height; y++) {
+        rows_by_gap[width - __builtin_popcount(g->rows[y])]++;
+    }
+    rows_by_gap[width] += need;
+    int cost = 0;
+    for (int gap = 1; gap <= width && need > 0; gap++) {
+        int take = rows_by_gap[gap] < need ? rows_by_gap[gap] : need;
+        cost += take * gap;
+        need -= take;
+    }
+    return cost;
+}
+
+static void report(Search *s, const Solution *path) {
+    pthread_mutex_lock(&s->lock);
+    if (s->found < s->c->max_solutions) {
+        s->fn(s->ctx, path);
+        if (++s->found == s->c->max_solutions) atomic_store_explicit(&s->stop, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+// --- Search ---
+// Plays p on a copy of the parent. Returns 0 when it cannot be played.
+static int play(const Search *s, const GameState *parent, int used, const Placement *p,
+                GameState *child, int *child_used) {
+    int pull = p->hold && parent->hold_idx < 0; // Hold takes the next piece
+    if (pull && used >= s->n_next) return 0;
+    game_copy(child, parent);
+    if (!game_place(child, p)) return 0;
+    *child_used = used + 1 + pull;
+    return 1;
+}
+
+#define SOLVED -2 // judge(): path is a solution, now reported
+#define PRUNED -1 // judge(): nothing to find below
+
+// What a child just played onto path is worth searching: its shortfall,
+// or one of the two above.
+static int judge(Search *s, const GameState *child, int child_used, const Solution *path, Counts *k) {
+    k->nodes++;
+    if (reached(s, child)) {
+        report(s, path);
+        return SOLVED;
+    }
+    int cells_left = 4 * remaining(s, child_used, path->count);
+    int gap = child->state == GAME_PLAY ? shortfall(s, child, cells_left) : -1;
+    if (gap < 0 || gap > cells_left) {
+        k->pruned++;
+        return PRUNED;
+    }
+    return gap;
+}
+
+typedef struct {
+    int gap;
+    int index;
+} Ranked;
+
+// Depth first from g, children closest to the goal first. Returns the
+// number of solutions below it.
+static int search(Search *s, GameState *g, int used, Solution *path, Counts *k) {
+    int r = remaining(s, used, path->count);
+    if (r == 0 || atomic_load_explicit(&s->stop, memory_order_relaxed)) return 0;
+    feed(s, g, used);
+
+    TTable *tt = s->c->tt;
+    uint64_t key = 0, data;
+    if (tt) {
+        key = rng_mix(game_hash(g) ^ ((uint64_t)used << 32 | (uint64_t)g->lines_cleared_total));
+        if (tt_probe(tt, key, &data) && (int)data >= r) {
+            k->transpositions++;
+            return 0;
+        }
+    }
+
+    Placement pl[MOVEGEN_MAX];
+    Ranked order[MOVEGEN_MAX];
+    int count = gen_placements(g, pl, NULL, MOVEGEN_MAX), found = 0, n = 0, depth = path->count;
+    GameState child;
+    int child_used;
+    for (int i = 0; i < count; i++) {
+        if (!play(s, g, used, &pl[i], &child, &child_used)) continue;
+        path->moves[depth] = pl[i];
+        path->count = depth + 1;
+        int gap = judge(s, &child, child_used, path, k);
+        found += gap == SOLVED;
+        if (gap < 0) continue;
+        int j = n++;
+        for (; j > 0 && order[j - 1].gap > gap; j--) order[j] = order[j - 1];
+        order[j] = (Ranked){ gap, i };
+    }
+    for (int j = 0; j < n && !atomic_load_explicit(&s->stop, memory_order_relaxed); j++) {
+        const Placement *p = &pl[order[j].index];
+        play(s, g, used, p, &child, &child_used);
+        path->moves[depth] = *p;
+        path->count = depth + 1;
+        found += search(s, &child, child_used, path, k);
+    }
+    path->count = depth;
+    // An unfinished search proves nothing
+    if (tt && !found && !atomic_load_explicit(&s->stop, memory_order_relaxed)) tt_store(tt, key, (uint64_t)r, r);
+    return found;
+}
+
+static void add_counts(Search *s, const Counts *k) {
+    atomic_fetch_add_explicit(&s->nodes, k->nodes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->pruned, k->pruned, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->transpositions, k->transpositions, memory_order_relaxed);
+}
+
+static void run_tasks(void *ctx, long begin, long end, int worker) {
+    (void)worker;
+    Search *s = ctx;
+    Counts k = { 0 };
+    for (long i = begin; i < end; i++) {
+        Task *t = &s->tasks[i];
+        search(s, &t->g, t->used, &t->path, &k);
+    }
+    add_counts(s, &k);
+}
+
+static int by_gap(const void *a, const void *b) {
+    const Task *x = a, *y = b;
+    return (x->gap > y->gap) - (x->gap < y->gap);
+}
+
+// Expands the shallowest tasks breadth first until there are enough to
+// keep every worker busy, then puts the closest to the goal first.
+// Solutions found on the way are reported here.
+static int split(Search *s, int *count, Counts *k) {
+    int n = *count;
+    while (n > 0 && n < SPLIT_TASKS && !atomic_load_explicit(&s->stop, memory_order_relaxed)) {
+        int m = 0, cap = n * 64;
+        Task *out = malloc(cap * sizeof(Task));
+        if (!out) return -1;
+        for (int i = 0; i < n; i++) {
+            Task *t = &s->tasks[i];
+            if (remaining(s, t->used, t->path.count) == 0) continue;
+            feed(s, &t->g, t->used);
+            Placement pl[MOVEGEN_MAX];
+            int c = gen_placements(&t->g, pl, NULL, MOVEGEN_MAX);
+            for (int j = 0; j < c; j++) {
+                if (m == cap) {
+                    Task *grown = realloc(out, 2 * cap * sizeof(Task));
+                    if (!grown) {
+                        free(out);
+                        return -1;
+                    }
+                    out = grown;
+                    cap *= 2;
+                }
+                Task *o = &out[m];
+                if (!play(s, &t->g, t->used, &pl[j], &o->g, &o->used)) continue;
+                o->path = t->path;
+                o->path.moves[o->path.count++] = pl[j];
+                o->gap = judge(s, &o->g, o->used, &o->path, k);
+                if (o->gap >= 0) m++;
+            }
+        }
+        free(s->tasks);
+        s->tasks = out;
+        n = m;
+    }
+    qsort(s->tasks, n, sizeof(Task), by_gap);
+    *count = n;
+    return 0;
+}
+
+int solve(const GameState *start, const uint8_t *next, int n_next, const SolveConfig *c,
+          SolveFn fn, void *ctx, SolveStats *stats) {
+    SolveConfig limits = *c;
+    if (limits.pieces > SOLVE_MAX_PIECES) limits.pieces = SOLVE_MAX_PIECES;
+    if (limits.max_solutions < 1) limits.max_solutions = 1;
+    Search s = { .c = &limits, .next = next, .n_next = n_next, .fn = fn, .ctx = ctx };
+    s.base_lines = start->lines_cleared_total;
+    s.tasks = malloc(sizeof(Task));
+    if (!s.tasks) return -1;
+    pthread_mutex_init(&s.lock, NULL);
+
+    int count = 1;
+    s.tasks[0].g = *start;
+    s.tasks[0].used = 0;
+    s.tasks[0].path.count = 0;
+    Counts k = { 0 };
+    int ok = limits.pool ? split(&s, &count, &k) : 0;
+    add_counts(&s, &k);
+    if (ok == 0) {
+        if (limits.pool) pool_parallel_for(limits.pool, count, 1, run_tasks, &s);
+        else run_tasks(&s, 0, count, 0);
+    }
+
+    if (stats) {
+        stats->nodes = atomic_load(&s.nodes);
+        stats->pruned = atomic_load(&s.pruned);
+        stats->transpositions = atomic_load(&s.transpositions);
+    }
+    pthread_mutex_destroy(&s.lock);
+    free(s.tasks);
+    return ok == 0 ? s.found : -1;
+}
+
+// --- Replay ---
+int solution_paths(const GameState *start, const uint8_t *next, int n_next, const Solution *sol, MovePath *paths) {
+    Search s = { .next = next, .n_next = n_next };
+    GameState g = *start;
+    int used = 0;
+    for (int i = 0; i < sol->count; i++) {
+        const Placement *p = &sol->moves[i];
+        feed(&s, &g, used);
+        Placement pl[MOVEGEN_MAX];
+        MovePath mp[MOVEGEN_MAX];
+        int count = gen_placements(&g, pl, mp, MOVEGEN_MAX), j = 0;
+        while (j < count && !(pl[j].piece.type == p->piece.type && pl[j].piece.rot == p->piece.rot &&
+                              pl[j].x == p->x && pl[j].y == p->y && pl[j].hold == p->hold)) j++;
+        if (j == count || mp[j].len == 0) return i;
+        paths[i] = mp[j];
+        while (paths[i].len > 1 && paths[i].actions[paths[i].len - 2] == ACT_SOFT_DROP) {
+            paths[i].actions[--paths[i].len - 1] = ACT_HARD_DROP; // The hard drop goes as far
+        }
+        used += 1 + (p->hold && g.hold_idx < 0);
+        game_place(&g, p);
+    }
+    return sol->count;
+}
@@ -0,0 +1,61 @@
+#ifndef TETRIS_SOLVER_H
+#define TETRIS_SOLVER_H
+
+#include <stdint.h>
+
+#include "engine.h"
+#include "movegen.h"
+#include "pool.h"
+#include "tt.h"
+
+// Puzzle solver: exhaustive search for placement sequences that reach a
+// perfect clear or clear a number of lines within a piece budget. Every
+// placement movegen finds is tried, hold included. Branches are cut when
+// the stack grows past the height limit, when the pieces left cannot
+// bring the cells to a whole number of rows (a perfect clear of n lines
+// needs n times the board width in cells and each piece adds four, so on
+// an even width an odd count never gets there), or when the rows still to
+// clear have more holes than the remaining pieces can fill. The first
+// levels of the tree are split across a thread pool; a transposition
+// table skips states already shown to fail.
+
+#define SOLVE_MAX_PIECES 64
+
+typedef struct {
+    int pieces;        // Placements a solution may use
+    int lines;         // Lines to clear; 0 asks for a perfect clear
+    int max_height;    // Highest the stack may get, in rows
+    int max_solutions; // Stop after this many
+    Pool *pool;        // NULL searches on the calling thread
+    TTable *tt;        // Remembers failed states; NULL for none
+} SolveConfig;
+
+typedef struct {
+    int count;
+    Placement moves[SOLVE_MAX_PIECES];
+} Solution;
+
+typedef struct {
+    uint64_t nodes;  // Placements played
+    uint64_t pruned; // Of those, cut without searching further
+    uint64_t transpositions;
+} SolveStats;
+
+// Called once per solution, never by two threads at a time.
+typedef void (*SolveFn)(void *ctx, const Solution *s);
+
+// Defaults: perfect clear within 10 pieces, height 4, first solution.
+void solve_config_init(SolveConfig *c);
+
+// `start` gives the board, current piece and hold; `next` the pieces that
+// come after the current one, which replace the bag. Returns the number
+// of solutions found, or -1 when out of memory.
+int solve(const GameState *start, const uint8_t *next, int n_next, const SolveConfig *c,
+          SolveFn fn, void *ctx, SolveStats *stats);
+
+// Steps the puzzle through s->moves, writing the inputs of each placement
+// to paths, without the soft drops a hard drop makes up for. Returns the
+// number of placements that could be replayed.
+int solution_paths(const GameState *start, const uint8_t *next, int n_next, const Solution *s, MovePath *paths);
+
+#endif
@@ -3,107 +3,72 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
-#include <sys/time.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
 #include <unistd.h>
 #include <termios.h>
-#include <sys/select.h>
 #include <fcntl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <locale.h>
 #include <wchar.h>
 #include <sys/ioctl.h>
 #include <limits.h>
-#include <math.h>
-
-// --- Constants & Config ---
-#define BOARD_WIDTH 10
-#define BOARD_HEIGHT 20
-#define FPS 60
-#define FRAME_DELAY_US (1000000 / FPS)
-
-// --- ANSI Colors & Styles ---
-#define C_RESET   "\033[0m"
-#define C_BOLD    "\033[1m"
-#define C_DIM     "\033[2m"
-#define C_REV     "\033[7m"
-
-// Foreground
-#define FG_BLACK  "\033[30m"
-#define FG_RED    "\033[31m"
-#define FG_GREEN  "\033[32m"
-#define FG_YELLOW "\033[33m"
-#define FG_BLUE   "\033[34m"
-#define FG_MAGENTA "\033[35m"
-#define FG_CYAN   "\033[36m"
-#define FG_WHITE  "\033[37m"
-#define FG_GRAY   "\033[90m"
-
-// Background
-#define BG_BLACK  "\033[40m"
-
-// --- Symbols ---
-#define SYM_BLOCK "██"
-#define SYM_SHADOW "░░"
-#define SYM_DOT   " ·"
-
-// Borders
-#define B_HORZ "══"
-#define B_VERT "║"
-#define B_TL   "╔"
-#define B_TR   "╗"
-#define B_BL   "╚"
-#define B_BR   "╝"
-
-// --- Game Structures ---
-typedef struct {
-    int x, y;
-} Point;
 
-typedef struct {
-    Point blocks[4];
-    int color_idx;
-    char *color_code;
-    int type_idx; // 0-6 for bag logic
-} Tetromino;
+#include "engine.h"
+#include "render.h"
+#include "input.h"
+#include "replay.h"
+#include "ai.h"
+#include "metrics.h"
+#include "net.h"
+#include "server.h"
+#include "feed.h"
 
 // --- Globals ---
-int board[BOARD_HEIGHT][BOARD_WIDTH] = {0};
-
-// Bag System
-int bag[7];
-int bag_head = 0;
-Tetromino next_queue[3]; // Show 3 next pieces
-
-// Hold System
-int hold_idx = -1; // -1 means empty
-int hold_locked = 0;
-
-Tetromino current_piece;
-int piece_x, piece_y;
-int score = 0;
+GameState game;
 int high_score = 0;
-int lines_cleared_total = 0;
-int level = 1;
 int game_running = 1;
-int game_state = 0; // 0 = PLAY, 1 = GAME_OVER
 int paused = 0;
+uint64_t game_seed;
 struct termios orig_termios;
-
-const char *GAME_OVER_ART[] = {
-    " GGG   AAA  M   M EEEE",
-    "G     A   A MM MM E   ",
-    "G  GG AAAAA M M M EEEE",
-    "G   G A   A M   M E   ",
-    " GGG  A   A M   M EEEE",
-    "",
-    " OOO  V   V EEEE RRRR ",
-    "O   O V   V E    R   R",
-    "O   O V   V EEEE RRRR ",
-    "O   O  V V  E    R R  ",
-    " OOO    V   EEEE R  RR"
-};
-const int GAME_OVER_ART_H = 11;
-const int GAME_OVER_ART_W = 22;
+Screen screen;
+int timer_fd = -1;  // Next gravity step
+int signal_fd = -1; // SIGWINCH and the quit signals
+double speed = 1.0;       // --speed time warp
+int64_t sim_origin_us;    // Wall time of sim tick 0
+int64_t sim_now = 0;      // Sim ticks elapsed
+int64_t next_drop = -1;   // Sim tick of the next gravity step, -1 when stopped
+int64_t timer_armed = -1; // Sim tick timer_fd is set for
+KeyParser key_parser;
+KeyQueue key_queue;
+AutoRepeat autorepeat;
+int das_ms = 150; // Held-key delay before auto-shift
+int arr_ms = 30;  // Auto-shift interval, 0 = straight to the wall
+ReplayWriter *recorder = NULL; // --record
+ReplayReader replay;           // --replay
+int replaying = 0;
+int autoplay = 0;          // --autoplay
+Ai *bot = NULL;
+Pool *bot_pool = NULL;     // Search threads
+Placement bot_target;      // Where the bot is taking the current piece
+int bot_planned = 0;
+int64_t bot_next_us = -1;  // Next bot input, -1 when idle
+int undo_depth = 0;        // --undo: pieces 'u' can take back
+int board_width = BOARD_WIDTH;   // --width
+int board_height = BOARD_HEIGHT; // --height
+Metrics metrics;
+const char *metrics_path = NULL; // --metrics: written on exit and SIGUSR1
+int show_metrics = 0;            // 'm': metrics in place of the controls
+int64_t sim_work_us = 0;         // Game work since the last frame
+int64_t key_pending_us = -1;     // Read time of the oldest key not on screen yet
+int tty_out = STDOUT_FILENO;     // Where frames are written; see enable_raw_mode()
+Feed *feed = NULL;               // --broadcast
+GameSnapshot feed_last;          // What the feed last got of the game
+uint16_t feed_last_tail[SNAPSHOT_TAIL_MAX];
+FeedReader *watched = NULL;      // --watch
 
 // --- Persistence ---
 void load_high_score() {
@@ -117,8 +82,10 @@ void load_high_score() {
 }
 
 void save_high_score() {
-    if (score > high_score) {
-        high_score = score;
+    if (replaying || autoplay || undo_depth || watched) return;
+    if (board_width != BOARD_WIDTH || board_height != BOARD_HEIGHT) return; // Not comparable
+    if (game.score > high_score) {
+        high_score = game.score;
         char path[512];
         snprintf(path, sizeof(path), "%s/.tetris_highscore", getenv("HOME"));
         FILE *f = fopen(path, "w");
@@ -129,45 +96,39 @@ void save_high_score() {
     }
 }
 
-// --- Tetromino Definitions ---
-const char* COLORS[] = {
-    C_RESET,
-    FG_CYAN,    // I
-    FG_BLUE,    // J
-    FG_YELLOW,  // L 
-    FG_WHITE,   // O
-    FG_GREEN,   // S
-    FG_MAGENTA, // T
-    FG_RED      // Z
-};
+// --- Metrics ---
+void metrics_sync() {
+    metrics.keys_dropped = key_queue.dropped;
+    metrics.esc_dropped = key_parser.dropped;
+}
 
-// Definition relative to top-left of 4x4 box
-const Tetromino SHAPES[7] = {
-    { { {0,1}, {1,1}, {2,1}, {3,1} }, 1, FG_CYAN, 0 },    // I
-    { { {0,0}, {0,1}, {1,1}, {2,1} }, 2, FG_BLUE, 1 },    // J
-    { { {2,0}, {0,1}, {1,1}, {2,1} }, 3, FG_YELLOW, 2 },  // L
-    { { {1,0}, {2,0}, {1,1}, {2,1} }, 4, FG_WHITE, 3 },   // O
-    { { {1,0}, {2,0}, {0,1}, {1,1} }, 5, FG_GREEN, 4 },   // S
-    { { {1,0}, {0,1}, {1,1}, {2,1} }, 6, FG_MAGENTA, 5 }, // T
-    { { {0,0}, {1,0}, {1,1}, {2,1} }, 7, FG_RED, 6 }      // Z
-};
+void dump_metrics() {
+    if (!metrics_path) return;
+    FILE *f = fopen(metrics_path, "w");
+    if (!f) return;
+    metrics_sync();
+    metrics_dump(&metrics, f);
+    fclose(f);
+}
+
+// --- Broadcast ---
+// Publishes the game to the --broadcast feed when it changed.
+void broadcast() {
+    GameSnapshot s;
+    uint16_t tail[SNAPSHOT_TAIL_MAX];
+    size_t tail_bytes = SNAPSHOT_TAIL(game.height) * sizeof(*tail);
+    game_snapshot(&game, &s, tail);
+    if (memcmp(&s, &feed_last, sizeof(s)) == 0 && memcmp(tail, feed_last_tail, tail_bytes) == 0) return;
+    feed_last = s;
+    memcpy(feed_last_tail, tail, tail_bytes);
+    feed_publish(feed, 0, &game);
+}
 
 // --- Prototypes ---
 void init_game();
-void reset_game();
 void cleanup();
-void spawn_piece();
-int check_collision(Tetromino p, int x, int y);
-void lock_piece();
-void rotate_piece();
-void drop_piece_hard();
-void hold_piece_action();
-void handle_input();
-void render();
-long get_time_ms();
-void shuffle_bag();
-void fill_next_queue();
-Tetromino pop_next_piece();
+void render(const GameState *g);
+void flush_frame();
 void load_high_score();
 void save_high_score();
 
@@ -185,572 +146,950 @@ void enable_raw_mode() {
     raw.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
     hide_cursor();
+    fflush(stdout);
+    // Frames never block; see flush_frame(). O_NONBLOCK goes on a
+    // descriptor of our own: fd 1 shares its flags with stdin and the
+    // shell, which would be left non-blocking by a crash. Without one,
+    // frames are written to stdout as it is and may block.
+    if (isatty(STDOUT_FILENO)) {
+        int fd = open("/proc/self/fd/1", O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd != -1) tty_out = fd;
+    }
 }
 
 void cleanup() {
     save_high_score();
+    dump_metrics();
+    if (tty_out != STDOUT_FILENO) {
+        // Blocking again, so the last frame goes out whole before the reset
+        fcntl(tty_out, F_SETFL, fcntl(tty_out, F_GETFL) & ~O_NONBLOCK);
+        flush_frame();
+        close(tty_out);
+        tty_out = STDOUT_FILENO;
+    }
     printf(C_RESET);
     show_cursor();
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
     printf("\033[2J\033[H");
+    feed_destroy(feed);
+    feed = NULL;
+    if (recorder) {
+        if (replay_writer_close(recorder) != 0) fprintf(stderr, "tetris: could not write the replay log\n");
+        recorder = NULL;
+    }
 }
 
-// --- Game Logic ---
-
-long get_time_ms() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+// --- Undo ---
+// A ring of the last undo_depth pieces as they spawned. Snapshots leave
+// colors out, so each entry keeps its own copy for the screen.
+typedef struct {
+    GameSnapshot s;
+    uint16_t tail[SNAPSHOT_TAIL_MAX];
+    uint8_t color[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+} UndoEntry;
+
+UndoEntry *undo_ring = NULL;
+int undo_len = 0, undo_head = 0; // Entries held; slot the next one goes in
+UndoEntry undo_spawn;            // The current piece
+int undo_pieces = -1;            // game.pieces when undo_spawn was taken
+
+void undo_mark() {
+    game_snapshot(&game, &undo_spawn.s, undo_spawn.tail);
+    memcpy(undo_spawn.color, game.color, sizeof(game.color));
+    undo_pieces = game.pieces;
 }
 
-void shuffle_bag() {
-    for (int i = 0; i < 7; i++) bag[i] = i;
-    for (int i = 6; i > 0; i--) {
-        int j = rand() % (i + 1);
-        int temp = bag[i];
-        bag[i] = bag[j];
-        bag[j] = temp;
+// Called after every change: a locked piece pushes the spawn it came
+// from, a new game forgets the old one.
+void undo_track() {
+    if (!undo_ring || game.pieces == undo_pieces) return;
+    if (game.pieces > undo_pieces) {
+        undo_ring[undo_head] = undo_spawn;
+        undo_head = (undo_head + 1) % undo_depth;
+        if (undo_len < undo_depth) undo_len++;
+    } else {
+        undo_len = 0;
     }
-    bag_head = 0;
+    undo_mark();
 }
 
-Tetromino get_from_bag() {
-    if (bag_head >= 7) {
-        shuffle_bag();
-    }
-    return SHAPES[bag[bag_head++]];
+// Puts the last locked piece back at the top. Returns 1 when there was one.
+int undo() {
+    if (!undo_ring || undo_len == 0) return 0;
+    undo_head = (undo_head + undo_depth - 1) % undo_depth;
+    undo_len--;
+    const UndoEntry *e = &undo_ring[undo_head];
+    game_restore(&game, &e->s, e->tail);
+    memcpy(game.color, e->color, sizeof(game.color));
+    undo_mark();
+    next_drop = -1; // Full gravity interval for the returned piece
+    return 1;
 }
 
-void fill_next_queue() {
-    // Initial fill
-    static int first = 1;
-    if (first) {
-        shuffle_bag();
-        for(int i=0; i<3; i++) next_queue[i] = get_from_bag();
-        first = 0;
-    }
+// --- Game Logic ---
+// Every change to the game goes through these, so --record and undo see it.
+int apply_action(Action a) {
+    if (recorder && a != ACT_NONE && game.state == GAME_PLAY) replay_record(recorder, a);
+    int changed = game_apply(&game, a);
+    undo_track();
+    return changed;
 }
 
-Tetromino pop_next_piece() {
-    Tetromino p = next_queue[0];
-    next_queue[0] = next_queue[1];
-    next_queue[1] = next_queue[2];
-    next_queue[2] = get_from_bag();
-    return p;
+int tick_game() {
+    if (recorder) replay_record_tick(recorder);
+    int changed = game_tick(&game);
+    undo_track();
+    return changed;
 }
 
 void reset_game() {
-    // Reset board
-    for(int y=0; y<BOARD_HEIGHT; y++)
-        for(int x=0; x<BOARD_WIDTH; x++)
-            board[y][x] = 0;
-            
-    score = 0;
-    lines_cleared_total = 0;
-    level = 1;
-    game_state = 0; // PLAY
-    hold_idx = -1;
-    hold_locked = 0;
-    
-    // Reshuffle queue
-    bag_head = 7; // Force reshuffle
-    // We need to re-init queue properly
-    // Just calling fill_next_queue logic:
-    shuffle_bag();
-    for(int i=0; i<3; i++) next_queue[i] = get_from_bag();
-    
-    spawn_piece();
+    if (recorder) replay_record(recorder, REPLAY_RESET);
+    game_reset(&game);
+    undo_track();
 }
 
 void init_game() {
-    srand(time(NULL));
     load_high_score();
     enable_raw_mode();
     setlocale(LC_ALL, ""); 
-    fill_next_queue();
-    spawn_piece();
+    screen_init(&screen);
+    game_init_sized(&game, game_seed, board_width, board_height);
+}
+
+// --- Event Sources ---
+// The main loop sleeps in poll() until a key arrives, the gravity timer
+// expires or a signal is pending. Signals are read from a signalfd, so
+// nothing runs in signal context.
+void init_events() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (signal_fd == -1 || timer_fd == -1) {
+        perror("tetris: event setup");
+        exit(1);
+    }
+}
+
+int64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-void spawn_piece() {
-    current_piece = pop_next_piece();
-    piece_x = BOARD_WIDTH / 2 - 2;
-    piece_y = 0;
-    hold_locked = 0;
+// --- Simulation Clock ---
+// Game time counts fixed SIM_HZ ticks from CLOCK_MONOTONIC, scaled by
+// --speed, so wall clock adjustments never reach it. Gravity steps are
+// scheduled on ticks and every step that came due is applied, however
+// late the loop wakes up. Only after a stall longer than MAX_CATCHUP_MS
+// (the process was stopped, the machine slept) does the clock skip ahead
+// instead of dropping the piece all at once.
+#define SIM_HZ 1000
+#define MAX_CATCHUP_MS 250
+
+int64_t sim_ticks_at(int64_t us) {
+    return (int64_t)((us - sim_origin_us) * speed * SIM_HZ / 1000000.0);
+}
 
-    if (check_collision(current_piece, piece_x, piece_y)) {
-        game_state = 1; // GAME_OVER
-        save_high_score();
+// First wall time at which `tick` has begun.
+int64_t sim_tick_us(int64_t tick) {
+    return sim_origin_us + (int64_t)(tick * 1000000.0 / (SIM_HZ * speed)) + 1;
+}
+
+void sim_advance() {
+    int64_t now = now_us();
+    int64_t t = sim_ticks_at(now);
+    int64_t max_behind = (int64_t)MAX_CATCHUP_MS * SIM_HZ / 1000;
+    if (next_drop >= 0 && t - next_drop > max_behind) {
+        sim_origin_us += (int64_t)((t - next_drop - max_behind) * 1000000.0 / (SIM_HZ * speed));
+        t = sim_ticks_at(now);
     }
+    if (t > sim_now) sim_now = t;
 }
 
-int check_collision(Tetromino p, int x, int y) {
-    for (int i = 0; i < 4; i++) {
-        int bx = x + p.blocks[i].x;
-        int by = y + p.blocks[i].y;
+int64_t drop_ticks() {
+    return (int64_t)game_drop_interval_ms(&game) * SIM_HZ / 1000;
+}
 
-        if (bx < 0 || bx >= BOARD_WIDTH || by >= BOARD_HEIGHT) return 1;
-        if (by >= 0 && board[by][bx]) return 1;
+// Schedules gravity only while a game is in play, and points timer_fd at
+// the next step. Starting it gives the piece a full drop interval.
+void sync_gravity() {
+    if (game.state != GAME_PLAY || paused) next_drop = -1;
+    else if (next_drop < 0) next_drop = sim_now + drop_ticks();
+    if (next_drop == timer_armed) return;
+
+    struct itimerspec its = { 0 };
+    if (next_drop >= 0) {
+        int64_t us = sim_tick_us(next_drop);
+        its.it_value.tv_sec = us / 1000000;
+        its.it_value.tv_nsec = us % 1000000 * 1000;
     }
-    return 0;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    timer_armed = next_drop;
 }
 
-void lock_piece() {
-    for (int i = 0; i < 4; i++) {
-        int bx = piece_x + current_piece.blocks[i].x;
-        int by = piece_y + current_piece.blocks[i].y;
-        if (by >= 0 && by < BOARD_HEIGHT && bx >= 0 && bx < BOARD_WIDTH) {
-            board[by][bx] = current_piece.color_idx;
-        }
+// Applies every gravity step due by sim_now. Returns 1 when the state changed.
+int run_gravity() {
+    int changed = 0;
+    while (next_drop >= 0 && next_drop <= sim_now && game.state == GAME_PLAY) {
+        changed |= tick_game();
+        next_drop += drop_ticks();
     }
+    return changed;
+}
 
-    int lines = 0;
-    for (int y = BOARD_HEIGHT - 1; y >= 0; y--) {
-        int full = 1;
-        for (int x = 0; x < BOARD_WIDTH; x++) {
-            if (board[y][x] == 0) {
-                full = 0;
-                break;
-            }
-        }
-        if (full) {
-            lines++;
-            for (int yy = y; yy > 0; yy--) {
-                for (int xx = 0; xx < BOARD_WIDTH; xx++) {
-                    board[yy][xx] = board[yy - 1][xx];
-                }
-            }
-            for (int xx = 0; xx < BOARD_WIDTH; xx++) board[0][xx] = 0;
-            y++; 
+void update_size() {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
+        ws.ws_col = 80;
+        ws.ws_row = 24;
+    }
+    screen_resize(&screen, ws.ws_col, ws.ws_row);
+}
+
+// Returns 1 when the screen needs a redraw.
+int handle_signals() {
+    struct signalfd_siginfo si;
+    int dirty = 0;
+    while (read(signal_fd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo == SIGWINCH) {
+            update_size();
+            dirty = 1;
+        } else if (si.ssi_signo == SIGUSR1) {
+            dump_metrics();
+        } else {
+            game_running = 0;
         }
     }
+    return dirty;
+}
 
-    if (lines > 0) {
-        lines_cleared_total += lines;
-        int points[] = {0, 100, 300, 500, 800};
-        score += points[lines] * level;
-        level = 1 + (lines_cleared_total / 10);
-        if (score > high_score) high_score = score;
+// --- Input ---
+// Drains every byte the terminal has buffered into the key queue.
+void read_input() {
+    char buf[256];
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0 || (n == -1 && errno == EINTR)) {
+        if (n > 0) key_parser_feed(&key_parser, buf, n, now_us(), &key_queue);
     }
+}
 
-    spawn_piece();
+Action key_action(int key) {
+    switch (key) {
+        case KEY_UP: case 'w': return ACT_ROTATE;
+        case KEY_DOWN: case 's': return ACT_SOFT_DROP;
+        case KEY_RIGHT: case 'd': return ACT_RIGHT;
+        case KEY_LEFT: case 'a': return ACT_LEFT;
+        case ' ': return ACT_HARD_DROP;
+        case 'c': case 'C': return ACT_HOLD;
+        default: return ACT_NONE;
+    }
 }
 
-void hold_piece_action() {
-    if (hold_locked) return; 
-    
-    if (hold_idx == -1) {
-        hold_idx = current_piece.type_idx;
-        spawn_piece(); // Spawns next from queue
+// Handles one key. Returns 1 when anything on screen changed.
+int handle_key(const KeyEvent *ev) {
+    if (ev->key == 'm') {
+        show_metrics = !show_metrics;
+        return 1;
+    }
+    if (autoplay) { // Watching: quit and pause only
+        if (ev->key == 'q') game_running = 0;
+        else if (ev->key == 'p' && game.state == GAME_PLAY) {
+            paused = !paused;
+            return 1;
+        }
+        return 0;
+    }
+    if (ev->key == 'u' && !paused) {
+        autorepeat_cancel(&autorepeat);
+        return undo();
+    }
+    if (game.state == GAME_OVER) {
+        if (ev->key == 'q') game_running = 0;
+        else if (ev->key == 'r') {
+            reset_game();
+            return 1;
+        }
+        return 0;
+    }
+
+    if (ev->key == 'q') {
+        game_running = 0;
+        return 0;
+    }
+    if (ev->key == 'p') {
+        paused = !paused;
+        autorepeat_cancel(&autorepeat);
+        return 1;
+    }
+
+    Action a = key_action(ev->key);
+    if (a == ACT_LEFT || a == ACT_RIGHT || a == ACT_SOFT_DROP) {
+        // Keyed by action, so 'a' and Left are the same held key
+        if (!autorepeat_press(&autorepeat, a, ev->time_us)) return 0;
     } else {
-        int temp = hold_idx;
-        hold_idx = current_piece.type_idx;
-        current_piece = SHAPES[temp];
-        piece_x = BOARD_WIDTH / 2 - 2;
-        piece_y = 0;
+        autorepeat_cancel(&autorepeat);
     }
-    hold_locked = 1;
+    return apply_action(a);
+}
+
+// Applies the shifts the held key has earned by now.
+int handle_autorepeat(int64_t now) {
+    Action a = autorepeat.key;
+    int n = autorepeat_due(&autorepeat, now);
+    int changed = 0;
+    while (n-- > 0 && apply_action(a)) changed = 1;
+    return changed;
 }
 
-void rotate_piece() {
-    Tetromino temp = current_piece;
-    if (current_piece.color_idx == 4) return; // O shape
+// --- Rendering ---
+#define FRAME_US 8333 // 120 frames a second at most
 
-    Point center = temp.blocks[1];
-    for (int i = 0; i < 4; i++) {
-        int x = temp.blocks[i].x;
-        int y = temp.blocks[i].y;
-        int rx = x - center.x;
-        int ry = y - center.y;
-        temp.blocks[i].x = center.x - ry;
-        temp.blocks[i].y = center.y + rx;
+// Frames go out through a non-blocking tty_out, so a slow terminal never
+// holds up gravity or input. The frame in flight owns its buffer, traded
+// with the screen's, and the next frame is only composed once the terminal
+// has taken all of it: whatever changed meanwhile goes out as one frame of
+// the latest state rather than a backlog of stale ones.
+typedef struct {
+    char *buf;
+    size_t cap, len, sent;
+    int64_t write_us; // Spent in write() so far
+    int64_t key_us;   // Read time of the oldest key it shows, -1 for none
+} FrameOut;
+
+FrameOut frame_out = { .key_us = -1 };
+
+int frame_busy() { return frame_out.sent < frame_out.len; }
+
+// Writes what the terminal takes of the frame in flight.
+void flush_frame() {
+    FrameOut *f = &frame_out;
+    int64_t t = now_us();
+    while (f->sent < f->len) {
+        ssize_t n = write(tty_out, f->buf + f->sent, f->len - f->sent);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1 && errno == EAGAIN) {
+            metrics.short_writes++;
+            break;
+        }
+        if (n <= 0) f->sent = f->len; // Terminal gone, and the frame with it
+        else if ((f->sent += n) < f->len) metrics.short_writes++;
     }
+    int64_t done = now_us();
+    f->write_us += done - t;
+    if (frame_busy()) return;
+
+    hist_add(&metrics.phase[PHASE_WRITE], f->write_us);
+    if (f->key_us >= 0) hist_add(&metrics.latency, done - f->key_us);
+    f->len = f->sent = 0;
+    f->write_us = 0;
+    f->key_us = -1;
+}
 
-    if (check_collision(temp, piece_x, piece_y)) {
-        if (!check_collision(temp, piece_x - 1, piece_y)) piece_x--;
-        else if (!check_collision(temp, piece_x + 1, piece_y)) piece_x++;
-        else return; 
+// Composes a frame of g and starts writing it. Only called when no frame
+// is in flight.
+void render(const GameState *g) {
+    char overlay[PANEL_OVERLAY_LINES][PANEL_TEXT_COLS + 1];
+    RenderInfo info = { high_score, paused, NULL, 0 };
+    if (show_metrics) {
+        metrics_sync();
+        info.overlay = overlay[0];
+        info.overlay_lines = metrics_overlay(&metrics, overlay[0], PANEL_TEXT_COLS, PANEL_OVERLAY_LINES);
     }
-    current_piece = temp;
+
+    int64_t t0 = now_us();
+    size_t len = render_frame(&screen, g, &info);
+    hist_add(&metrics.phase[PHASE_SIM], sim_work_us);
+    hist_add(&metrics.phase[PHASE_COMPOSE], now_us() - t0);
+    hist_add(&metrics.bytes, len);
+    sim_work_us = 0;
+
+    screen_swap_out(&screen, &frame_out.buf, &frame_out.cap);
+    frame_out.len = len;
+    frame_out.key_us = key_pending_us;
+    key_pending_us = -1;
+    flush_frame();
 }
 
-void drop_piece_hard() {
-    while (!check_collision(current_piece, piece_x, piece_y + 1)) {
-        piece_y++;
+// --- Replay ---
+void *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, n = 0, k;
+    char *data = malloc(cap);
+    while (data && (k = fread(data + n, 1, cap - n, f)) > 0) {
+        n += k;
+        if (n < cap) continue;
+        char *grown = realloc(data, cap *= 2);
+        if (!grown) free(data);
+        data = grown;
     }
-    lock_piece();
+    fclose(f);
+    *len = n;
+    return data;
 }
 
-int kbhit() {
-    struct timeval tv = { 0L, 0L };
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(STDIN_FILENO, &fds);
-    return select(STDIN_FILENO + 1, &fds, NULL, NULL, &tv);
+void print_game(void *ctx, const GameState *g) {
+    int *games = ctx;
+    printf("game %d: score %d lines %d level %d pieces %d\n",
+           ++*games, g->score, g->lines_cleared_total, g->level, g->pieces);
 }
 
-void handle_input() {
-    if (!kbhit()) return;
+// --replay --fast: re-simulates the log without a terminal and prints the
+// result of every game in it.
+int replay_fast(const void *data, size_t len) {
+    int games = 0;
+    int64_t start = now_us();
+    replay_run(data, len, print_game, &games);
+    printf("replayed %d game%s in %.3f ms\n", games, games == 1 ? "" : "s", (now_us() - start) / 1000.0);
+    return 0;
+}
 
-    char c;
-    if (read(STDIN_FILENO, &c, 1) != 1) return;
+// Actions due before the next tick: the current record once its ticks are
+// used up, plus every record right behind it that has no ticks.
+int replay_group(const ReplayRecord *rec, int more) {
+    if (rec->ticks > 0 || !more) return 0;
+    ReplayReader ahead = replay;
+    ReplayRecord r;
+    int n = 1;
+    while (replay_next(&ahead, &r) && r.ticks == 0) n++;
+    return n;
+}
 
-    if (c == '\033') {
-        char seq[3];
-        if (read(STDIN_FILENO, &seq[0], 1) == 0) return;
-        if (read(STDIN_FILENO, &seq[1], 1) == 0) return;
-        
-        if (seq[0] == '[') {
-            if (game_state == 0) {
-                switch (seq[1]) {
-                    case 'A': rotate_piece(); break; // Up
-                    case 'B': if (!check_collision(current_piece, piece_x, piece_y + 1)) piece_y++; break; // Down
-                    case 'C': if (!check_collision(current_piece, piece_x + 1, piece_y)) piece_x++; break; // Right
-                    case 'D': if (!check_collision(current_piece, piece_x - 1, piece_y)) piece_x--; break; // Left
-                }
-            }
+// Wall time one gravity step takes at the current level and --speed.
+int64_t step_us() {
+    return (int64_t)(game_drop_interval_ms(&game) * 1000.0 / speed);
+}
+
+// --replay: plays the log back at game speed. Every tick takes the drop
+// interval of the level at the time, and the actions between two ticks
+// are spread evenly over it.
+void play_replay() {
+    struct pollfd fds[] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { signal_fd, POLLIN, 0 },
+        { -1, POLLOUT, 0 },
+    };
+    ReplayRecord rec;
+    int more = replay_next(&replay, &rec);
+    int64_t t0 = now_us();
+    int64_t interval = step_us();
+    int group = replay_group(&rec, more), done = 0;
+    int dirty = 1;
+
+    while (game_running) {
+        if (dirty && !frame_busy()) {
+            render(&game);
+            dirty = 0;
         }
-    } else {
-        if (game_state == 0) { // PLAY
-            switch(c) {
-                case 'q': game_running = 0; break;
-                case 'p': paused = !paused; break;
-                case ' ': drop_piece_hard(); break;
-                case 'c': case 'C': hold_piece_action(); break;
-                case 'w': rotate_piece(); break;
-                case 'a': if (!check_collision(current_piece, piece_x - 1, piece_y)) piece_x--; break;
-                case 's': if (!check_collision(current_piece, piece_x, piece_y + 1)) piece_y++; break;
-                case 'd': if (!check_collision(current_piece, piece_x + 1, piece_y)) piece_x++; break;
-            }
-        } else { // GAME_OVER
-            switch(c) {
-                case 'q': game_running = 0; break;
-                case 'r': reset_game(); break;
+
+        int finished = rec.ticks == 0 && !more;
+        int64_t next = rec.ticks > 0 ? t0 + interval : t0 + (done + 1) * interval / (group + 1);
+        int timeout = -1;
+        if (!finished) {
+            int64_t wait = next - now_us();
+            timeout = wait <= 0 ? 0 : (int)((wait + 999) / 1000);
+        }
+        fds[2].fd = frame_busy() ? tty_out : -1;
+        if (poll(fds, 3, timeout) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[2].revents) flush_frame();
+        if (fds[0].revents & POLLIN) {
+            read_input();
+            KeyEvent ev;
+            while (key_queue_pop(&key_queue, &ev)) {
+                if (ev.key == 'q') game_running = 0;
             }
+        } else if (fds[0].revents & (POLLHUP | POLLERR)) {
+            game_running = 0;
         }
+        if (fds[1].revents & POLLIN) dirty |= handle_signals();
+        if (feed) broadcast();
+
+        if (finished || now_us() < next) continue;
+        if (rec.ticks > 0) {
+            game_tick(&game);
+            rec.ticks--;
+            t0 = next;
+            interval = step_us();
+            group = replay_group(&rec, more);
+            done = 0;
+        } else {
+            replay_apply(&game, &rec);
+            more = replay_next(&replay, &rec);
+            done++;
+        }
+        dirty = 1;
     }
-    tcflush(STDIN_FILENO, TCIFLUSH);
 }
 
-// --- Rendering ---
+// --- Spectating ---
+// Shows the --watch game of a --broadcast feed, looking for news once a
+// frame. Nothing goes back to the feed, so watchers cost the player nothing.
+void watch_feed() {
+    struct pollfd fds[] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { signal_fd, POLLIN, 0 },
+        { -1, POLLOUT, 0 },
+    };
+    FeedEntry e;
+    int dirty = 1;
 
-void render() {
-    static int last_w = 0, last_h = 0;
-    struct winsize ws;
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1) {
-        ws.ws_col = 80;
-        ws.ws_row = 24;
-    }
-    
-    int term_w = ws.ws_col;
-    int term_h = ws.ws_row;
-    
-    static char frame_buffer[262144]; 
-    char *p = frame_buffer;
-    
-    if (term_w != last_w || term_h != last_h) {
-        p += sprintf(p, "\033[2J");
-        last_w = term_w;
-        last_h = term_h;
-    }
-    p += sprintf(p, "\033[H");
-
-    // --- Dynamic Scaling ---
-    int panel_width_chars = 26;
-    int extra_margin_w = 6; 
-    int extra_margin_h = 3; 
-
-    int available_h = term_h - extra_margin_h;
-    int available_w_for_board = term_w - panel_width_chars - extra_margin_w;
-
-    int blk_h = available_h / BOARD_HEIGHT;
-    if (blk_h < 1) blk_h = 1;
-    
-    int max_blk_h_by_width = available_w_for_board / (BOARD_WIDTH * 2);
-    if (blk_h > max_blk_h_by_width) blk_h = max_blk_h_by_width;
-    
-    int blk_w = blk_h * 2; 
-
-    int board_pixel_w = BOARD_WIDTH * blk_w;
-    int board_pixel_h = BOARD_HEIGHT * blk_h;
-    
-    int total_content_w = board_pixel_w + 2 + 2 + panel_width_chars + 2;
-    int total_content_h = board_pixel_h + 2;
-
-    int margin_top = (term_h - total_content_h) / 2;
-    if (margin_top < 0) margin_top = 0;
-    int margin_left = (term_w - total_content_w) / 2;
-    if (margin_left < 0) margin_left = 0;
-
-    int start_col = margin_left + 1;
-
-    // Ghost Piece
-    int ghost_y = piece_y;
-    while (!check_collision(current_piece, piece_x, ghost_y + 1)) {
-        ghost_y++;
-    }
-
-    // -- Draw Top Spacing --
-    for (int i = 0; i < margin_top; i++) p += sprintf(p, "\n");
-
-    // -- Top Border --
-    p += sprintf(p, "\033[%dG", start_col);
-    p += sprintf(p, C_BOLD FG_WHITE B_TL);
-    for (int i = 0; i < board_pixel_w / 2; i++) p += sprintf(p, B_HORZ); 
-    for (int i = 0; i < board_pixel_w % 2; i++) p += sprintf(p, B_HORZ); 
-    p += sprintf(p, B_TR);
-    
-    p += sprintf(p, "  "); 
-    
-    p += sprintf(p, B_TL);
-    for (int i = 0; i < panel_width_chars - 2; i++) p += sprintf(p, B_HORZ);
-    p += sprintf(p, B_TR C_RESET "\n");
-
-    // -- Main Board & Panel Loop --
-    for (int y = 0; y < BOARD_HEIGHT; y++) {
-        for (int sub_y = 0; sub_y < blk_h; sub_y++) {
-            // Move to start column
-            p += sprintf(p, "\033[%dG", start_col);
-            
-            // Board Left Border
-            p += sprintf(p, C_BOLD FG_WHITE B_VERT C_RESET);
-            
-            // Board Row Content
-            // Handle GAME OVER Overlay
-            int is_overlay_line = 0;
-            int overlay_row = -1;
-            
-            if (game_state == 1) {
-                int current_pixel_y = y * blk_h + sub_y;
-                
-                // We map to art lines. 
-                // Just center vertically roughly. 
-                // Since blk_h varies, mapping art to block grid is tricky if art is text.
-                // Let's just overlay text centered on lines.
-                
-                int center_y = BOARD_HEIGHT * blk_h / 2;
-                int start_art_y = center_y - GAME_OVER_ART_H / 2;
-                
-                if (current_pixel_y >= start_art_y && current_pixel_y < start_art_y + GAME_OVER_ART_H) {
-                    is_overlay_line = 1;
-                    overlay_row = current_pixel_y - start_art_y;
-                }
-            }
+    while (game_running) {
+        if (feed_latest(watched, &e)) {
+            feed_restore(&game, &e);
+            dirty = 1;
+        }
+        if (dirty && !frame_busy()) {
+            render(&game);
+            dirty = 0;
+        }
 
-            if (is_overlay_line) {
-                // Print Art Line Centered
-                // Clear board area first? Or draw over.
-                // Let's calculate padding.
-                const char *art_line = GAME_OVER_ART[overlay_row];
-                int art_len = GAME_OVER_ART_W;
-                int pad_left = (board_pixel_w - art_len) / 2;
-                if (pad_left < 0) pad_left = 0;
-                
-                // Print background/margin
-                for(int i=0; i<pad_left; i++) p += sprintf(p, " ");
-                // Print Art
-                p += sprintf(p, C_BOLD FG_RED "%s" C_RESET, art_line);
-                // Print remaining
-                int rem = board_pixel_w - pad_left - art_len;
-                for(int i=0; i<rem; i++) p += sprintf(p, " ");
-                
-            } else {
-                for (int x = 0; x < BOARD_WIDTH; x++) {
-                    int is_active = 0;
-                    int is_ghost = 0;
-                    if (game_state == 0) {
-                        for (int k = 0; k < 4; k++) {
-                            if (current_piece.blocks[k].x + piece_x == x && current_piece.blocks[k].y + piece_y == y) is_active = 1;
-                            if (current_piece.blocks[k].x + piece_x == x && current_piece.blocks[k].y + ghost_y == y) is_ghost = 1;
-                        }
-                    }
-                    
-                    const char *bg_col = "";
-                    
-                    if (is_active) {
-                         bg_col = current_piece.color_code;
-                    } else if (board[y][x] != 0) {
-                         bg_col = COLORS[board[y][x]];
-                    } else if (is_ghost) {
-                         bg_col = C_DIM FG_WHITE;
-                    } else {
-                         bg_col = C_DIM FG_GRAY;
-                    }
-
-                    p += sprintf(p, "%s", bg_col);
-                    for(int bw=0; bw < blk_w; bw+=2) {
-                        if (is_active || board[y][x] != 0) p += sprintf(p, "██");
-                        else if (is_ghost) p += sprintf(p, "░░");
-                        else { 
-                             if (bw == 0 && (sub_y == blk_h/2 || blk_h == 1)) p += sprintf(p, " ·");
-                             else p += sprintf(p, "  ");
-                        }
-                    }
-                    p += sprintf(p, C_RESET);
+        fds[2].fd = frame_busy() ? tty_out : -1;
+        if (poll(fds, 3, FRAME_US / 1000) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[2].revents) flush_frame();
+        if (fds[0].revents & POLLIN) {
+            read_input();
+            KeyEvent ev;
+            while (key_queue_pop(&key_queue, &ev)) {
+                if (ev.key == 'q') game_running = 0;
+                if (ev.key == 'm') {
+                    show_metrics = !show_metrics;
+                    dirty = 1;
                 }
             }
+        } else if (fds[0].revents & (POLLHUP | POLLERR)) {
+            game_running = 0;
+        }
+        if (fds[1].revents & POLLIN) dirty |= handle_signals();
+    }
+}
 
-            // Board Right Border
-            p += sprintf(p, C_BOLD FG_WHITE B_VERT C_RESET);
-
-            // Gap
-            p += sprintf(p, "  ");
-
-            // -- Side Panel --
-            p += sprintf(p, C_BOLD FG_WHITE B_VERT C_RESET " ");
-            
-            // Robust Side Panel Layout
-            int visual_line_idx = y * blk_h + sub_y;
-            int total_lines = BOARD_HEIGHT * blk_h;
-            
-            int content_h = 30;
-            int slack = total_lines - content_h;
-            if (slack < 0) slack = 0;
-            
-            int gap = slack / 4; 
-            int margin_top_panel = gap;
-            
-            int y_next = margin_top_panel;
-            int y_hold = y_next + 11 + gap;
-            int y_stats = y_hold + 6 + gap;
-            int y_ctrl = y_stats + 8 + gap; 
-            
-            char panel_str[256] = "";
-            
-            if (game_state == 1) {
-                 int go_y = total_lines / 2 - 4;
-                 // Adjust go_y to avoid conflicting with Art if needed, but side panel is separate.
-                 // Just align vaguely center.
-                 if (visual_line_idx == go_y) sprintf(panel_str, C_BOLD FG_RED "GAME OVER" C_RESET);
-                 else if (visual_line_idx == go_y + 2) sprintf(panel_str, "Final: " FG_YELLOW "%d" C_RESET, score);
-                 else if (visual_line_idx == go_y + 3) sprintf(panel_str, "High : " FG_YELLOW "%d" C_RESET, high_score);
-                 else if (visual_line_idx == go_y + 5) sprintf(panel_str, "R: Retry");
-                 else if (visual_line_idx == go_y + 6) sprintf(panel_str, "Q: Quit");
-            } else {
-                // NEXT SECTION
-                if (visual_line_idx == y_next) sprintf(panel_str, C_BOLD FG_CYAN "NEXT PIECE" C_RESET);
-                else if (visual_line_idx >= y_next + 2 && visual_line_idx <= y_next + 10) {
-                    int row_rel = visual_line_idx - (y_next + 2);
-                    int p_slot = row_rel / 3;
-                    int p_row = row_rel % 3;
-                    if (p_slot < 3 && p_row < 2) {
-                         Tetromino np = next_queue[p_slot];
-                         char buf[128] = "    ";
-                         for(int px=0; px<4; px++) {
-                             int f=0; 
-                             for(int k=0; k<4; k++) if(np.blocks[k].x==px && np.blocks[k].y==p_row) f=1;
-                             if(f) { strcat(buf, np.color_code); strcat(buf, "██" C_RESET); } else strcat(buf, "  ");
-                         }
-                         sprintf(panel_str, "%s", buf);
-                    }
-                }
-                
-                // HOLD SECTION
-                else if (visual_line_idx == y_hold) sprintf(panel_str, C_BOLD FG_MAGENTA "HOLD (C)" C_RESET);
-                else if (visual_line_idx >= y_hold + 2 && visual_line_idx <= y_hold + 5) {
-                    if (hold_idx != -1) {
-                         Tetromino hp = SHAPES[hold_idx];
-                         int h_row = visual_line_idx - (y_hold + 2);
-                         char buf[128] = "    ";
-                         for(int px=0; px<4; px++) {
-                             int f=0; 
-                             for(int k=0; k<4; k++) if(hp.blocks[k].x==px && hp.blocks[k].y==h_row) f=1;
-                             if(f) { strcat(buf, hp.color_code); strcat(buf, "██" C_RESET); } else strcat(buf, "  ");
-                         }
-                         sprintf(panel_str, "%s", buf);
-                    } else {
-                        if(visual_line_idx == y_hold + 3) sprintf(panel_str, C_DIM "    Empty" C_RESET);
-                    }
-                }
-                
-                // STATS SECTION
-                else if (visual_line_idx == y_stats) sprintf(panel_str, "SCORE: " FG_YELLOW "%d" C_RESET, score);
-                else if (visual_line_idx == y_stats + 1) sprintf(panel_str, C_DIM "HIGH:  " FG_YELLOW "%d" C_RESET, high_score);
-                else if (visual_line_idx == y_stats + 3) sprintf(panel_str, "LEVEL: " FG_GREEN "%d" C_RESET, level);
-                else if (visual_line_idx == y_stats + 5) sprintf(panel_str, "LINES: " FG_WHITE "%d" C_RESET, lines_cleared_total);
-                
-                // CONTROLS SECTION
-                else if (visual_line_idx == y_ctrl) sprintf(panel_str, C_DIM "Controls:" C_RESET);
-                else if (visual_line_idx == y_ctrl + 1) sprintf(panel_str, C_DIM "Arrows/WASD" C_RESET);
-                else if (visual_line_idx == y_ctrl + 2) sprintf(panel_str, C_DIM "Space : Drop" C_RESET);
-                else if (visual_line_idx == y_ctrl + 3) sprintf(panel_str, C_DIM "C     : Hold" C_RESET);
-                else if (visual_line_idx == y_ctrl + 4) sprintf(panel_str, C_DIM "P     : Pause" C_RESET);
-                else if (visual_line_idx == y_ctrl + 6) {
-                     if(paused) sprintf(panel_str, C_BOLD FG_RED " PAUSED " C_RESET);
-                }
-            }
+// --- Autoplay ---
+// The bot picks a target for each piece, then walks there one input at a
+// time through apply_action(), so gravity, rendering and --record see an
+// ordinary game. Every step takes the shortest path from wherever the
+// piece is now, which keeps it on course when gravity moves the piece.
+#define BOT_STEP_MS 50       // Between inputs, or a quarter drop interval
+#define BOT_RESTART_MS 3000  // Game over screen before the next game
+
+int same_cells(const Placement *a, const Placement *b) {
+    const PieceShape *ma = PIECE_SHAPE(&a->piece), *mb = PIECE_SHAPE(&b->piece);
+    return a->piece.type == b->piece.type && a->hold == b->hold &&
+           a->x + ma->left == b->x + mb->left && a->y + ma->top == b->y + mb->top &&
+           !memcmp(ma->rows, mb->rows, sizeof(ma->rows));
+}
+
+// Next input towards bot_target, ACT_NONE when it is out of reach.
+Action bot_next_action() {
+    Placement pl[MOVEGEN_MAX];
+    MovePath paths[MOVEGEN_MAX];
+    int n = gen_placements(&game, pl, paths, MOVEGEN_MAX);
+    for (int i = 0; i < n; i++) {
+        if (same_cells(&pl[i], &bot_target)) return paths[i].len ? (Action)paths[i].actions[0] : ACT_NONE;
+    }
+    return ACT_NONE;
+}
+
+// One bot input. Returns 1 when the state changed.
+int bot_step() {
+    if (!bot_planned) {
+        if (!ai_choose(bot, &game, &bot_target)) return apply_action(ACT_HARD_DROP);
+        bot_planned = 1;
+    }
+    Action a = bot_next_action();
+    if (a == ACT_NONE) {
+        bot_planned = 0; // Lost its way; plan again
+        return 0;
+    }
+    if (a == ACT_HOLD) bot_target.hold = 0;
+    if (a == ACT_HARD_DROP) bot_planned = 0;
+    return apply_action(a);
+}
+
+int64_t bot_step_us() {
+    int ms = game_drop_interval_ms(&game) / 4;
+    if (ms > BOT_STEP_MS) ms = BOT_STEP_MS;
+    return (int64_t)(ms * 1000.0 / speed);
+}
 
-            p += sprintf(p, "%s", panel_str);
-            
-            int right_border_col = start_col + board_pixel_w + panel_width_chars + 3;
-            p += sprintf(p, "\033[%dG", right_border_col); 
-            
-            p += sprintf(p, " " C_BOLD FG_WHITE B_VERT C_RESET "\n");
+// Runs the bot's input if it is due, restarting after a game over, and
+// schedules the next one.
+int run_bot(int64_t now) {
+    if (paused) {
+        bot_next_us = -1;
+        return 0;
+    }
+    int changed = 0;
+    if (bot_next_us >= 0 && now >= bot_next_us) {
+        if (game.state == GAME_OVER) {
+            reset_game();
+            bot_planned = 0;
+            changed = 1;
+        } else {
+            changed = bot_step();
         }
+        bot_next_us = -1;
+    }
+    if (bot_next_us < 0) {
+        bot_next_us = now + (game.state == GAME_OVER ? (int64_t)(BOT_RESTART_MS * 1000 / speed) : bot_step_us());
     }
+    return changed;
+}
 
-    // -- Bottom Border --
-    p += sprintf(p, "\033[%dG", start_col);
-    p += sprintf(p, C_BOLD FG_WHITE B_BL);
-    for (int i = 0; i < board_pixel_w / 2; i++) p += sprintf(p, B_HORZ);
-    for (int i = 0; i < board_pixel_w % 2; i++) p += sprintf(p, B_HORZ);
-    p += sprintf(p, B_BR);
-    
-    p += sprintf(p, "  ");
-    
-    p += sprintf(p, B_BL);
-    for (int i = 0; i < panel_width_chars - 2; i++) p += sprintf(p, B_HORZ);
-    p += sprintf(p, B_BR C_RESET "\n");
+// --autoplay --headless: plays without a terminal or gravity, as fast as
+// the search goes, until a game over or max_pieces.
+int autoplay_headless(int max_pieces, TTable *tt) {
+    game_init_sized(&game, game_seed, board_width, board_height);
+    int64_t start = now_us();
+    while (game.state == GAME_PLAY && game.pieces < max_pieces) {
+        // Every move goes through apply_action() so --record can play it
+        // back. A choice with no path in MOVE_PATH_MAX inputs, as deep
+        // spins on tall boards can need, is dropped where the piece is.
+        Placement p;
+        Placement pl[MOVEGEN_MAX];
+        MovePath paths[MOVEGEN_MAX];
+        int n = 0, i = 0;
+        if (ai_choose(bot, &game, &p)) {
+            n = gen_placements(&game, pl, paths, MOVEGEN_MAX);
+            while (i < n && !same_cells(&pl[i], &p)) i++;
+        }
+        if (i == n || paths[i].len == 0) {
+            apply_action(ACT_HARD_DROP);
+            continue;
+        }
+        for (int k = 0; k < paths[i].len; k++) apply_action((Action)paths[i].actions[k]);
+    }
+    double secs = (now_us() - start) / 1e6;
+    int games = 0;
+    print_game(&games, &game);
+    printf("%d pieces in %.3f s, %.0f pieces/s\n", game.pieces, secs, game.pieces / secs);
+    if (tt) {
+        TTStats st;
+        tt_stats(tt, &st);
+        printf("tt %zu KiB: %llu hits, %llu misses (%.1f%% hit), %llu stores\n", tt_bytes(tt) >> 10,
+               (unsigned long long)st.hits, (unsigned long long)st.misses,
+               100.0 * st.hits / (st.hits + st.misses ? st.hits + st.misses : 1), (unsigned long long)st.stores);
+    }
+    return 0;
+}
 
-    write(STDOUT_FILENO, frame_buffer, p - frame_buffer);
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--seed N] [--speed X] [--das MS] [--arr MS] [--record FILE | --undo N]\n"
+                    "                [--width N] [--height N] [--metrics FILE] [--broadcast NAME]\n"
+                    "       %s --autoplay [--headless [--pieces N]] [--threads N] [--beam N] [--tt MB]\n"
+                    "                [--seed N] [--speed X] [--record FILE] [--width N] [--height N]\n"
+                    "                [--broadcast NAME]\n"
+                    "       %s --replay FILE [--speed X] [--fast] [--broadcast NAME]\n"
+                    "       %s --serve ADDR [--seats N] [--seed N] [--width N] [--height N]\n"
+                    "                [--broadcast NAME]\n"
+                    "       %s --watch NAME [--game N]\n"
+                    "ADDR is unix:PATH or [HOST:]PORT and NAME a shared memory name like /tetris.\n"
+                    "Boards are %dx%d by default and %d to %d wide, %d to %d high.\n", prog, prog, prog, prog, prog,
+            BOARD_WIDTH, BOARD_HEIGHT, BOARD_MIN_SIZE, BOARD_MAX_WIDTH, BOARD_MIN_SIZE, BOARD_MAX_HEIGHT);
 }
 
 int main(int argc, char *argv[]) {
     int new_window = 0;
-    if (argc > 1 && strcmp(argv[1], "--new-window") == 0) new_window = 1;
+    int have_seed = 0;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    int fast = 0;
+    int headless = 0;
+    int max_pieces = 100000;
+    int threads = 0;
+    int tt_mb = 0;
+    const char *serve_addr = NULL;
+    const char *feed_name = NULL;
+    const char *watch_name = NULL;
+    uint32_t watch_game = 0;
+    ServeConfig serve_config;
+    serve_config_init(&serve_config);
+    AiConfig bot_config;
+    ai_config_init(&bot_config);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--new-window") == 0) new_window = 1;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            game_seed = strtoull(argv[++i], NULL, 0);
+            have_seed = 1;
+        } else if (strcmp(argv[i], "--das") == 0 && i + 1 < argc) {
+            das_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--arr") == 0 && i + 1 < argc) {
+            arr_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            fast = 1;
+        } else if (strcmp(argv[i], "--autoplay") == 0) {
+            autoplay = 1;
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--pieces") == 0 && i + 1 < argc) {
+            max_pieces = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--beam") == 0 && i + 1 < argc) {
+            bot_config.beam = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tt") == 0 && i + 1 < argc) {
+            tt_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--undo") == 0 && i + 1 < argc) {
+            undo_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_addr = argv[++i];
+        } else if (strcmp(argv[i], "--seats") == 0 && i + 1 < argc) {
+            serve_config.seats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc) {
+            feed_name = argv[++i];
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_name = argv[++i];
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            watch_game = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            board_width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            board_height = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // A replay log has no way to say "undo"
+    if (!(speed > 0) || (headless && !autoplay) || (autoplay && replay_path) ||
+        undo_depth < 0 || (undo_depth && (record_path || replay_path || autoplay)) ||
+        board_width < BOARD_MIN_SIZE || board_width > BOARD_MAX_WIDTH ||
+        board_height < BOARD_MIN_SIZE || board_height > BOARD_MAX_HEIGHT ||
+        serve_config.seats < 1 || serve_config.seats > NET_MAX_SEATS ||
+        (watch_name && (feed_name || serve_addr || autoplay || replay_path || record_path || undo_depth)) ||
+        (feed_name && (headless || fast))) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!have_seed) game_seed = rng_mix(((uint64_t)time(NULL) << 20) ^ getpid());
+
+    if (serve_addr) {
+        serve_config.width = board_width;
+        serve_config.height = board_height;
+        serve_config.seed = game_seed;
+        if (feed_name && !(serve_config.feed = feed_create(feed_name))) {
+            perror(feed_name);
+            return 1;
+        }
+        int failed = serve(serve_addr, &serve_config) != 0;
+        if (failed) perror(serve_addr);
+        feed_destroy(serve_config.feed);
+        return failed;
+    }
 
-    if (!new_window && getenv("DISPLAY") != NULL) {
+    void *replay_data = NULL;
+    if (replay_path) {
+        size_t len = 0;
+        replay_data = read_file(replay_path, &len);
+        if (!replay_data) {
+            perror(replay_path);
+            return 1;
+        }
+        if (replay_reader_init(&replay, replay_data, len) != 0 ||
+            replay.width < BOARD_MIN_SIZE || replay.width > BOARD_MAX_WIDTH ||
+            replay.height < BOARD_MIN_SIZE || replay.height > BOARD_MAX_HEIGHT) {
+            fprintf(stderr, "%s: not a replay log\n", replay_path);
+            return 1;
+        }
+        if (fast) return replay_fast(replay_data, len);
+        game_seed = replay.seed;
+        board_width = replay.width;
+        board_height = replay.height;
+        replaying = 1;
+    }
+
+    if (autoplay) {
+        bot_pool = pool_create(threads);
+        bot_config.pool = bot_pool;
+        if (tt_mb > 0) bot_config.tt = tt_create((size_t)tt_mb << 20);
+        bot = ai_create(&bot_config);
+        if (!bot || (tt_mb > 0 && !bot_config.tt)) {
+            fprintf(stderr, "tetris: out of memory for the autoplayer\n");
+            return 1;
+        }
+    }
+
+    if (undo_depth) {
+        undo_ring = malloc(undo_depth * sizeof(UndoEntry));
+        if (!undo_ring) {
+            fprintf(stderr, "tetris: out of memory for --undo\n");
+            return 1;
+        }
+    }
+
+    if (!new_window && !headless && getenv("DISPLAY") != NULL) {
         char path[PATH_MAX];
         ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
         if (len != -1) {
             path[len] = '\0';
-            execlp("gnome-terminal", "gnome-terminal", "--", path, "--new-window", NULL);
-            execlp("konsole", "konsole", "-e", path, "--new-window", NULL);
-            execlp("xfce4-terminal", "xfce4-terminal", "-x", path, "--new-window", NULL);
-            execlp("xterm", "xterm", "-e", path, "--new-window", NULL);
+            // Relaunch with the same options inside a new terminal window.
+            char *args[argc + 5];
+            int n = 0;
+            args[n++] = NULL; // terminal
+            args[n++] = NULL; // its "run this" flag
+            args[n++] = path;
+            args[n++] = "--new-window";
+            for (int i = 1; i < argc; i++) args[n++] = argv[i];
+            args[n] = NULL;
+
+            static const char *terms[][2] = {
+                { "gnome-terminal", "--" },
+                { "konsole", "-e" },
+                { "xfce4-terminal", "-x" },
+                { "xterm", "-e" },
+            };
+            for (int t = 0; t < 4; t++) {
+                args[0] = (char *)terms[t][0];
+                args[1] = (char *)terms[t][1];
+                execvp(args[0], args);
+            }
             fprintf(stderr, "Warning: Could not spawn a new terminal window.\n");
         }
     }
 
+    if (record_path && !replaying) {
+        recorder = replay_writer_open(record_path, game_seed, board_width, board_height);
+        if (!recorder) {
+            perror(record_path);
+            return 1;
+        }
+    }
+
+    // Late, so that nothing returns before cleanup() can remove the feed
+    if (feed_name) {
+        feed = feed_create(feed_name);
+        if (!feed) {
+            perror(feed_name);
+            return 1;
+        }
+    }
+    if (watch_name) {
+        watched = feed_open(watch_name, watch_game);
+        if (!watched) {
+            perror(watch_name);
+            return 1;
+        }
+    }
+
+    if (headless) {
+        autoplay_headless(max_pieces, bot_config.tt);
+        if (recorder && replay_writer_close(recorder) != 0) {
+            fprintf(stderr, "tetris: could not write the replay log\n");
+            return 1;
+        }
+        return 0;
+    }
+
     init_game();
-    
-    long last_drop_time = get_time_ms();
-    
+    init_events();
+    update_size();
+    if (replaying) {
+        play_replay();
+        cleanup();
+        return 0;
+    }
+    if (watched) {
+        watch_feed();
+        feed_close(watched);
+        cleanup();
+        return 0;
+    }
+    autorepeat_init(&autorepeat, das_ms < 0 ? 0 : das_ms, arr_ms < 0 ? 0 : arr_ms);
+    if (undo_ring) undo_mark();
+
+    struct pollfd fds[] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { timer_fd, POLLIN, 0 },
+        { signal_fd, POLLIN, 0 },
+        { -1, POLLOUT, 0 }, // stdout, while a frame is in flight
+    };
+    int was_over = 0;
+    int dirty = 1;
+    int64_t next_frame = 0;
+    sim_origin_us = now_us();
+
     while (game_running) {
-        long current_time = get_time_ms();
-        
-        handle_input();
-        
-        if (game_state == 0 && !paused) {
-            double speed_factor = pow(0.9, (double)(level - 1));
-            int drop_interval = (int)(1000.0 * speed_factor);
-            if (drop_interval < 50) drop_interval = 50;
-
-            if (current_time - last_drop_time > drop_interval) {
-                if (!check_collision(current_piece, piece_x, piece_y + 1)) {
-                    piece_y++;
-                } else {
-                    lock_piece();
+        sync_gravity();
+        // Frames follow the game rather than the other way round: at most
+        // one per FRAME_US, however many steps a warped clock runs, and
+        // none while the terminal is still taking the last one.
+        if (dirty && !frame_busy() && now_us() >= next_frame) {
+            render(&game);
+            dirty = 0;
+            next_frame = now_us() + FRAME_US;
+        }
+
+        // Sleep until input, gravity, a signal, the held key's next shift,
+        // the bot's next input, a frame that is waiting or room for the one
+        // in flight
+        int64_t deadline = autorepeat_deadline(&autorepeat);
+        if (autoplay) {
+            int64_t t = now_us();
+            dirty |= run_bot(t);
+            deadline = bot_next_us;
+            sim_work_us += now_us() - t;
+        }
+        if (dirty && !frame_busy() && (deadline < 0 || next_frame < deadline)) deadline = next_frame;
+        int timeout = -1;
+        if (deadline >= 0) {
+            int64_t wait = deadline - now_us();
+            timeout = wait <= 0 ? 0 : (int)((wait + 999) / 1000);
+        }
+        fds[3].fd = frame_busy() ? tty_out : -1;
+        if (poll(fds, 4, timeout) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[3].revents) flush_frame();
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            read(timer_fd, &expirations, sizeof(expirations));
+        }
+        int64_t work = now_us();
+        sim_advance();
+        dirty |= run_gravity();
+        if (fds[0].revents & POLLIN) {
+            read_input();
+            KeyEvent ev;
+            while (game_running && key_queue_pop(&key_queue, &ev)) {
+                metrics.keys++;
+                if (handle_key(&ev)) {
+                    dirty = 1;
+                    if (key_pending_us < 0) key_pending_us = ev.time_us;
                 }
-                last_drop_time = current_time;
             }
+        } else if (fds[0].revents & (POLLHUP | POLLERR)) {
+            game_running = 0; // Terminal went away
         }
+        dirty |= handle_autorepeat(now_us());
+        sim_work_us += now_us() - work;
+        if (fds[2].revents & POLLIN) dirty |= handle_signals();
+
+        if (feed) broadcast();
 
-        render();
-        
-        long render_end = get_time_ms();
-        long elapsed = render_end - current_time;
-        long sleep_time = (1000 / 60) - elapsed;
-        if (sleep_time > 0) usleep(sleep_time * 1000);
+        if (game.state == GAME_OVER && !was_over) save_high_score();
+        was_over = game.state == GAME_OVER;
     }
 
     cleanup();
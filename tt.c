@@ -0,0 +1,131 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tt.h"
+
+#define BUCKET_SLOTS 4
+#define DEPTH_BITS 0xFFull // Low byte of `check`; the bucket index covers those key bits
+#define STRIPES 16         // Counter copies, so threads do not share a line
+
+typedef struct {
+    _Atomic uint64_t check; // (key ^ data) with the depth in the low byte
+    _Atomic uint64_t data;
+} Slot;
+
+typedef struct {
+    _Alignas(64) Slot slots[BUCKET_SLOTS];
+} Bucket;
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t hits;
+    _Atomic uint64_t misses;
+    _Atomic uint64_t stores;
+} Stripe;
+
+_Static_assert(sizeof(Bucket) == 64, "a bucket is one cache line");
+_Static_assert(TT_MIN_BYTES / sizeof(Bucket) > DEPTH_BITS, "the bucket index must cover the depth bits");
+
+struct TTable {
+    Bucket *buckets;
+    uint64_t mask; // Buckets - 1
+    Stripe stripes[STRIPES];
+};
+
+static _Atomic int next_stripe;
+static _Thread_local int stripe = -1;
+
+static Stripe *my_stripe(TTable *t) {
+    if (stripe < 0) stripe = atomic_fetch_add_explicit(&next_stripe, 1, memory_order_relaxed) % STRIPES;
+    return &t->stripes[stripe];
+}
+
+TTable *tt_create(size_t bytes) {
+    if (bytes < TT_MIN_BYTES) bytes = TT_MIN_BYTES;
+    size_t buckets = 1;
+    while (buckets * 2 * sizeof(Bucket) <= bytes) buckets *= 2;
+
+    TTable *t = aligned_alloc(64, sizeof(TTable));
+    if (!t) return NULL;
+    t->buckets = aligned_alloc(64, buckets * sizeof(Bucket));
+    if (!t->buckets) {
+        free(t);
+        return NULL;
+    }
+    t->mask = buckets - 1;
+    tt_clear(t);
+    return t;
+}
+
+void tt_destroy(TTable *t) {
+    if (!t) return;
+    free(t->buckets);
+    free(t);
+}
+
+size_t tt_bytes(const TTable *t) {
+    return (t->mask + 1) * sizeof(Bucket);
+}
+
+void tt_clear(TTable *t) {
+    memset(t->buckets, 0, tt_bytes(t));
+    memset(t->stripes, 0, sizeof(t->stripes));
+}
+
+static inline int slot_holds(uint64_t check, uint64_t data, uint64_t key) {
+    return ((check ^ data) & ~DEPTH_BITS) == (key & ~DEPTH_BITS);
+}
+
+void tt_prefetch(const TTable *t, uint64_t key) {
+    __builtin_prefetch(&t->buckets[key & t->mask]);
+}
+
+int tt_probe(TTable *t, uint64_t key, uint64_t *data) {
+    Bucket *b = &t->buckets[key & t->mask];
+    for (int i = 0; i < BUCKET_SLOTS; i++) {
+        uint64_t d = atomic_load_explicit(&b->slots[i].data, memory_order_relaxed);
+        uint64_t c = atomic_load_explicit(&b->slots[i].check, memory_order_relaxed);
+        if ((c | d) && slot_holds(c, d, key)) {
+            atomic_fetch_add_explicit(&my_stripe(t)->hits, 1, memory_order_relaxed);
+            *data = d;
+            return 1;
+        }
+    }
+    atomic_fetch_add_explicit(&my_stripe(t)->misses, 1, memory_order_relaxed);
+    return 0;
+}
+
+// Writes are two plain stores. Racing writers can leave a slot whose
+// halves do not match, which every later probe takes for a miss.
+void tt_store(TTable *t, uint64_t key, uint64_t data, int depth) {
+    Bucket *b = &t->buckets[key & t->mask];
+    Slot *victim = NULL;
+    int victim_depth = 256;
+    for (int i = 0; i < BUCKET_SLOTS; i++) {
+        Slot *s = &b->slots[i];
+        uint64_t c = atomic_load_explicit(&s->check, memory_order_relaxed);
+        uint64_t d = atomic_load_explicit(&s->data, memory_order_relaxed);
+        if (!(c | d) || slot_holds(c, d, key)) {
+            victim = s;
+            break;
+        }
+        if ((int)(c & DEPTH_BITS) < victim_depth) {
+            victim = s;
+            victim_depth = (int)(c & DEPTH_BITS);
+        }
+    }
+    if (depth < 0) depth = 0;
+    if (depth > 255) depth = 255;
+    atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+    atomic_store_explicit(&victim->check, ((key ^ data) & ~DEPTH_BITS) | (uint64_t)depth, memory_order_relaxed);
+    atomic_fetch_add_explicit(&my_stripe(t)->stores, 1, memory_order_relaxed);
+}
+
+void tt_stats(const TTable *t, TTStats *s) {
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < STRIPES; i++) {
+        s->hits += atomic_load_explicit(&t->stripes[i].hits, memory_order_relaxed);
+        s->misses += atomic_load_explicit(&t->stripes[i].misses, memory_order_relaxed);
+        s->stores += atomic_load_explicit(&t->stripes[i].stores, memory_order_relaxed);
+    }
+}
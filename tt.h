@@ -0,0 +1,38 @@
+#ifndef TETRIS_TT_H
+#define TETRIS_TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Transposition table: a fixed-size map from 64-bit state hashes (see
+// game_hash()) to 64 bits of caller data, shared by any number of threads
+// without locks. Each slot stores the data and key ^ data, so a slot torn
+// by two racing writers reads as a miss instead of wrong data. Buckets of
+// four slots fill one cache line; a full bucket gives up the slot with the
+// lowest depth.
+
+typedef struct TTable TTable;
+
+typedef struct {
+    uint64_t hits, misses, stores;
+} TTStats;
+
+// Uses at most `bytes` (at least TT_MIN_BYTES). NULL when out of memory.
+#define TT_MIN_BYTES (16 * 1024)
+TTable *tt_create(size_t bytes);
+void tt_destroy(TTable *t);
+size_t tt_bytes(const TTable *t);
+// Empties the table and zeroes the counters. Not safe during lookups.
+void tt_clear(TTable *t);
+
+// Starts loading the bucket of `key`, for callers that know their keys a
+// little before they probe.
+void tt_prefetch(const TTable *t, uint64_t key);
+// Returns 1 and sets *data when `key` is in the table.
+int tt_probe(TTable *t, uint64_t key, uint64_t *data);
+// `depth` (0-255) is how much work the data stands for: deeper entries
+// outlive shallower ones.
+void tt_store(TTable *t, uint64_t key, uint64_t data, int depth);
+void tt_stats(const TTable *t, TTStats *s);
+
+#endif